@@ -0,0 +1,125 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+//    This file is part of QtAMD.                                            //
+//    Copyright (C) 2015-2016 Jacob Dawid, jacob@omg-it.works                //
+//                                                                           //
+//    QtAMD is free software: you can redistribute it and/or modify          //
+//    it under the terms of the GNU Affero General Public License as         //
+//    published by the Free Software Foundation, either version 3 of the     //
+//    License, or (at your option) any later version.                        //
+//                                                                           //
+//    QtAMD is distributed in the hope that it will be useful,               //
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of         //
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          //
+//    GNU Affero General Public License for more details.                    //
+//                                                                           //
+//    You should have received a copy of the GNU General Public License      //
+//    along with QtAMD. If not, see <http://www.gnu.org/licenses/>.          //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+
+#include "adaptertopology.h"
+
+#include <QHash>
+#include <QSet>
+
+#include <algorithm>
+
+namespace {
+
+// Returns a string equal to text, sharing its data with an equal string
+// returned before.
+QString intern(QSet<QString>& strings, const char *text) {
+    QString string = QString::fromLocal8Bit(text);
+    QSet<QString>::const_iterator interned = strings.constFind(string);
+    if(interned != strings.constEnd()) {
+        return *interned;
+    }
+    strings.insert(string);
+    return string;
+}
+
+}
+
+AdapterTopology::AdapterTopology() {
+}
+
+AdapterTopology::AdapterTopology(const QList<AdapterInfo>& adapters, const QVector<int>& activeAdapterIndices) {
+    int numberOfAdapters = 0;
+    for(int i = 0; i < adapters.size(); i++) {
+        numberOfAdapters = qMax(numberOfAdapters, adapters.at(i).iAdapterIndex + 1);
+    }
+    _deviceIndexOfAdapter = QVector<int>(numberOfAdapters, -1);
+
+    QSet<QString> strings;
+    // Device indices, keyed by bus, device and function number.
+    QHash<quint32, int> deviceIndices;
+
+    for(int i = 0; i < adapters.size(); i++) {
+        const AdapterInfo& info = adapters.at(i);
+        if(info.iAdapterIndex < 0) {
+            continue;
+        }
+
+        quint32 location = ((quint32)(info.iBusNumber & 0xffff) << 16)
+                         | ((info.iDeviceNumber & 0xff) << 8)
+                         | (info.iFunctionNumber & 0xff);
+        int deviceIndex = deviceIndices.value(location, -1);
+        if(deviceIndex < 0) {
+            Device device;
+            device.busNumber = info.iBusNumber;
+            device.deviceNumber = info.iDeviceNumber;
+            device.functionNumber = info.iFunctionNumber;
+            device.vendorID = info.iVendorID;
+            device.udid = intern(strings, info.strUDID);
+            device.name = intern(strings, info.strAdapterName);
+
+            deviceIndex = _devices.size();
+            deviceIndices.insert(location, deviceIndex);
+            _devices.append(device);
+        }
+
+        Device& device = _devices[deviceIndex];
+        device.adapterIndices.append(info.iAdapterIndex);
+        if(activeAdapterIndices.contains(info.iAdapterIndex)) {
+            device.activeAdapterIndices.append(info.iAdapterIndex);
+        }
+        _deviceIndexOfAdapter[info.iAdapterIndex] = deviceIndex;
+    }
+
+    for(int i = 0; i < _devices.size(); i++) {
+        Device& device = _devices[i];
+        std::sort(device.adapterIndices.begin(), device.adapterIndices.end());
+        std::sort(device.activeAdapterIndices.begin(), device.activeAdapterIndices.end());
+        device.adapterIndex = device.activeAdapterIndices.isEmpty() ? device.adapterIndices.first() : device.activeAdapterIndices.first();
+    }
+}
+
+int AdapterTopology::size() const {
+    return _devices.size();
+}
+
+const AdapterTopology::Device& AdapterTopology::at(int deviceIndex) const {
+    return _devices.at(deviceIndex);
+}
+
+const QVector<AdapterTopology::Device>& AdapterTopology::devices() const {
+    return _devices;
+}
+
+int AdapterTopology::deviceIndexOf(int adapterIndex) const {
+    if(adapterIndex < 0 || adapterIndex >= _deviceIndexOfAdapter.size()) {
+        return -1;
+    }
+    return _deviceIndexOfAdapter.at(adapterIndex);
+}
+
+int AdapterTopology::canonicalAdapterIndex(int adapterIndex) const {
+    int deviceIndex = deviceIndexOf(adapterIndex);
+    return deviceIndex < 0 ? -1 : _devices.at(deviceIndex).adapterIndex;
+}
+
+int AdapterTopology::numberOfAdapters() const {
+    return _deviceIndexOfAdapter.size();
+}
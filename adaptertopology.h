@@ -0,0 +1,74 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+//    This file is part of QtAMD.                                            //
+//    Copyright (C) 2015-2016 Jacob Dawid, jacob@omg-it.works                //
+//                                                                           //
+//    QtAMD is free software: you can redistribute it and/or modify          //
+//    it under the terms of the GNU Affero General Public License as         //
+//    published by the Free Software Foundation, either version 3 of the     //
+//    License, or (at your option) any later version.                        //
+//                                                                           //
+//    QtAMD is distributed in the hope that it will be useful,               //
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of         //
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          //
+//    GNU Affero General Public License for more details.                    //
+//                                                                           //
+//    You should have received a copy of the GNU General Public License      //
+//    along with QtAMD. If not, see <http://www.gnu.org/licenses/>.          //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <QString>
+#include <QVector>
+
+#include "amdoverdrive.h"
+
+/**
+ * The adapters of a rig, with one entry per PCI bus/device/function. ADL
+ * reports one AdapterInfo per display output, so all logical adapters of
+ * a device are folded into a single entry, and strings that are the same
+ * for many devices are only stored once. A topology is never modified
+ * after it has been built, so it can be shared between threads.
+ */
+class AdapterTopology {
+public:
+    struct Device {
+        int busNumber;
+        int deviceNumber;
+        int functionNumber;
+        int vendorID;
+        // Interned, so devices of the same model share the string data.
+        QString udid;
+        QString name;
+        // ADL adapter indices of all outputs of this device, ascending.
+        QVector<int> adapterIndices;
+        // The subset reported active by ADL_Adapter_Active_Get.
+        QVector<int> activeAdapterIndices;
+        // The adapter index used for calls on this device: the first
+        // active one, or the first one if none is active.
+        int adapterIndex;
+    };
+
+    AdapterTopology();
+    AdapterTopology(const QList<AdapterInfo>& adapters, const QVector<int>& activeAdapterIndices);
+
+    int size() const;
+    const Device& at(int deviceIndex) const;
+    const QVector<Device>& devices() const;
+
+    // Index of the device an ADL adapter belongs to, -1 if unknown.
+    int deviceIndexOf(int adapterIndex) const;
+    // The adapter index used for calls on the device an ADL adapter
+    // belongs to, -1 if unknown.
+    int canonicalAdapterIndex(int adapterIndex) const;
+    // Number of logical ADL adapters.
+    int numberOfAdapters() const;
+
+private:
+    QVector<Device> _devices;
+    // Indexed by ADL adapter index.
+    QVector<int> _deviceIndexOfAdapter;
+};
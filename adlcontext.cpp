@@ -0,0 +1,184 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+//    This file is part of QtAMD.                                            //
+//    Copyright (C) 2015-2016 Jacob Dawid, jacob@omg-it.works                //
+//                                                                           //
+//    QtAMD is free software: you can redistribute it and/or modify          //
+//    it under the terms of the GNU Affero General Public License as         //
+//    published by the Free Software Foundation, either version 3 of the     //
+//    License, or (at your option) any later version.                        //
+//                                                                           //
+//    QtAMD is distributed in the hope that it will be useful,               //
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of         //
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          //
+//    GNU Affero General Public License for more details.                    //
+//                                                                           //
+//    You should have received a copy of the GNU General Public License      //
+//    along with QtAMD. If not, see <http://www.gnu.org/licenses/>.          //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "adlcontext.h"
+#include "adlmemory.h"
+
+#include <QHash>
+#include <QMutexLocker>
+#include <QDebug>
+
+void* __stdcall ADL_Main_Memory_Alloc(int iSize) {
+    return ADLMemory::allocate(iSize);
+}
+
+void __stdcall ADL_Main_Memory_Free(void** lpBuffer) {
+    if (NULL != *lpBuffer) {
+        ADLMemory::free(*lpBuffer);
+        *lpBuffer = NULL;
+    }
+}
+
+namespace {
+
+// Live contexts by library path. A context is created and destroyed with
+// the mutex held, so ADL_Main_Control_Create for a new context can't run
+// while the old one is still being destroyed.
+QMutex registryMutex;
+QHash<QString, ADLContext*> registry;
+
+}
+
+QSharedPointer<ADLContext> ADLContext::acquire(const QString& libraryPath) {
+    QMutexLocker locker(&registryMutex);
+    ADLContext *context = registry.value(libraryPath, 0);
+    if(!context) {
+        context = new ADLContext(libraryPath);
+        registry.insert(libraryPath, context);
+    }
+    context->_users++;
+    return QSharedPointer<ADLContext>(context, &ADLContext::release);
+}
+
+void ADLContext::release(ADLContext *context) {
+    QMutexLocker locker(&registryMutex);
+    context->_users--;
+    if(context->_users == 0) {
+        registry.remove(context->_libraryPath);
+        delete context;
+    }
+}
+
+ADLContext::ADLContext(const QString& libraryPath)
+    : _libraryPath(libraryPath),
+      _users(0),
+      _initializationResult(ADL_ERR_NOT_INIT),
+      _generation(0) {
+#if defined Q_OS_LINUX
+    if(libraryPath.isEmpty()) {
+        _dll = dlopen("libatiadlxx.so", RTLD_LAZY | RTLD_GLOBAL);
+    } else {
+        _dll = dlopen(libraryPath.toLocal8Bit().constData(), RTLD_LAZY | RTLD_GLOBAL);
+    }
+#else
+    if(libraryPath.isEmpty()) {
+        _dll = LoadLibrary("atiadlxx.dll");
+        if(_dll == NULL)
+            // A 32 bit calling application on 64 bit OS will fail to LoadLibrary.
+            // Try to load the 32 bit library (atiadlxy.dll) instead
+            _dll = LoadLibrary("atiadlxy.dll");
+    } else {
+        _dll = LoadLibrary(libraryPath.toLocal8Bit().constData());
+    }
+#endif
+
+    // Resolve all entry points once, so calls don't have to look them up.
+    _adl.resolve(_dll);
+
+    if(_dll) {
+        create();
+    } else {
+        if(libraryPath.isEmpty()) {
+            qDebug() << "AMDOverdrive: libatiadlxx.so/atiadlxx.dll/atiadlxy.dll not found.";
+        } else {
+            qDebug() << "AMDOverdrive:" << libraryPath << "not found.";
+        }
+    }
+}
+
+ADLContext::~ADLContext() {
+    destroy();
+    if(_dll) {
+#if defined Q_OS_LINUX
+        dlclose(_dll);
+#else
+        FreeLibrary(_dll);
+#endif
+    }
+}
+
+QString ADLContext::libraryPath() const {
+    return _libraryPath;
+}
+
+bool ADLContext::isLoaded() const {
+    return _dll != 0;
+}
+
+const ADLFunctionTable& ADLContext::functions() const {
+    return _adl;
+}
+
+int ADLContext::initializationResult() const {
+    return _initializationResult.load();
+}
+
+bool ADLContext::isInitialized() const {
+    return _initializationResult.load() == ADL_OK;
+}
+
+int ADLContext::generation() const {
+    return _generation.load();
+}
+
+int ADLContext::reinitialize(int knownGeneration) {
+    QMutexLocker locker(&_mutex);
+    if(_generation.load() != knownGeneration) {
+        return _initializationResult.load();
+    }
+
+    destroy();
+    int returnCode = create();
+    _generation.fetchAndAddOrdered(1);
+    return returnCode;
+}
+
+ADL_CONTEXT_HANDLE ADLContext::createPrivateContext(int *returnCode) {
+    ADL_CONTEXT_HANDLE context = 0;
+    *returnCode = QTAMD_ERR_FUNCTION_NOT_AVAILABLE;
+    if(_adl.supportsADL2()) {
+        *returnCode = _adl.ADL2_Main_Control_Create(ADL_Main_Memory_Alloc, 1, &context);
+    }
+    return *returnCode == ADL_OK ? context : 0;
+}
+
+void ADLContext::destroyPrivateContext(ADL_CONTEXT_HANDLE context) {
+    if(context) {
+        ((ADL2Function<ADL_MAIN_CONTROL_DESTROY>::Type)_adl.adl2[ADLFunction::ADL_Main_Control_Destroy])(context);
+        ADLMemory::retireArena();
+    }
+}
+
+int ADLContext::create() {
+    int returnCode = QTAMD_ERR_FUNCTION_NOT_AVAILABLE;
+    if(_adl.has(ADLFunction::ADL_Main_Control_Create)) {
+        returnCode = _adl.ADL_Main_Control_Create(ADL_Main_Memory_Alloc, 1);
+    }
+    _initializationResult.store(returnCode);
+    return returnCode;
+}
+
+void ADLContext::destroy() {
+    if(_initializationResult.load() == ADL_OK && _adl.has(ADLFunction::ADL_Main_Control_Destroy)) {
+        _adl.ADL_Main_Control_Destroy();
+        ADLMemory::retireArena();
+    }
+    _initializationResult.store(ADL_ERR_NOT_INIT);
+}
@@ -0,0 +1,91 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+//    This file is part of QtAMD.                                            //
+//    Copyright (C) 2015-2016 Jacob Dawid, jacob@omg-it.works                //
+//                                                                           //
+//    QtAMD is free software: you can redistribute it and/or modify          //
+//    it under the terms of the GNU Affero General Public License as         //
+//    published by the Free Software Foundation, either version 3 of the     //
+//    License, or (at your option) any later version.                        //
+//                                                                           //
+//    QtAMD is distributed in the hope that it will be useful,               //
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of         //
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          //
+//    GNU Affero General Public License for more details.                    //
+//                                                                           //
+//    You should have received a copy of the GNU General Public License      //
+//    along with QtAMD. If not, see <http://www.gnu.org/licenses/>.          //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <QString>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QSharedPointer>
+
+#include "amdoverdrive.h"
+
+/**
+ * A loaded ADL library and its ADL_Main_Control_Create initialisation. ADL
+ * keeps one global context per process, so all AMDOverdrive objects using
+ * the same library share one ADLContext. The context is destroyed with
+ * ADL_Main_Control_Destroy and the library unloaded when the last of them
+ * lets go.
+ */
+class ADLContext {
+public:
+    // The shared context for libraryPath, loaded and initialised on first
+    // use. An empty path loads the system's ADL library.
+    static QSharedPointer<ADLContext> acquire(const QString& libraryPath);
+
+    QString libraryPath() const;
+    bool isLoaded() const;
+    // Entry points resolved when the library was loaded.
+    const ADLFunctionTable& functions() const;
+
+    // Return code of the last ADL_Main_Control_Create.
+    int initializationResult() const;
+    bool isInitialized() const;
+
+    // Incremented by every reinitialisation, so users sharing the context
+    // can tell that their cached state is stale.
+    int generation() const;
+    // Destroys and creates the ADL context again, e.g. to recover from a
+    // driver reset. Does nothing if the context has been reinitialised
+    // since knownGeneration, so users sharing it only recover once.
+    int reinitialize(int knownGeneration);
+
+    // Independent ADL2 contexts, which unlike the global one can be used
+    // from several threads at once. Only available if the library exports
+    // ADL2, see ADLFunctionTable::supportsADL2(). Returns 0 on failure.
+    ADL_CONTEXT_HANDLE createPrivateContext(int *returnCode);
+    void destroyPrivateContext(ADL_CONTEXT_HANDLE context);
+
+private:
+    ADLContext(const QString& libraryPath);
+    ~ADLContext();
+    Q_DISABLE_COPY(ADLContext)
+
+    // Deleter of the pointers acquire() returns. Destroys the context with
+    // the last of them.
+    static void release(ADLContext *context);
+
+    int create();
+    void destroy();
+
+    QString _libraryPath;
+    // acquire() calls not released yet, guarded by the registry's mutex.
+    int _users;
+#if defined Q_OS_LINUX
+    void *_dll;
+#else
+    HINSTANCE _dll;
+#endif
+    ADLFunctionTable _adl;
+
+    QMutex _mutex;
+    QAtomicInt _initializationResult;
+    QAtomicInt _generation;
+};
@@ -23,7 +23,10 @@
 #include <QtCore>
 #include <QDebug>
 
+#include <stdio.h>
+
 typedef int ( *ADL_MAIN_CONTROL_CREATE )(ADL_MAIN_MALLOC_CALLBACK, int );
+typedef int ( *ADL2_MAIN_CONTROL_CREATE )(ADL_MAIN_MALLOC_CALLBACK, int, ADL_CONTEXT_HANDLE* );
 typedef int ( *ADL_MAIN_CONTROL_DESTROY )();
 typedef int ( *ADL_ADAPTER_NUMBEROFADAPTERS_GET ) ( int* );
 typedef int ( *ADL_ADAPTER_ADAPTERINFO_GET ) ( LPAdapterInfo, int );
@@ -59,7 +62,62 @@ typedef int ( *ADL_OVERDRIVE6_FANSPEED_SET )(int iAdapterIndex, ADLOD6FanSpeedVa
 typedef int ( *ADL_OVERDRIVE6_STATE_SET )(int iAdapterIndex, int iStateType, ADLOD6StateInfo *lpStateInfo);
 typedef int ( *ADL_OVERDRIVE6_POWERCONTROL_SET )(int iAdapterIndex, int iValue);
 
-void *loadFunction(void *dll, const char *name) {
+// All ADL entry points used by QtAMD as (typedef, symbol) pairs.
+#define QTAMD_ADL_FUNCTIONS(F) \
+    F(ADL_MAIN_CONTROL_CREATE, ADL_Main_Control_Create) \
+    F(ADL_MAIN_CONTROL_DESTROY, ADL_Main_Control_Destroy) \
+    F(ADL_ADAPTER_NUMBEROFADAPTERS_GET, ADL_Adapter_NumberOfAdapters_Get) \
+    F(ADL_ADAPTER_ADAPTERINFO_GET, ADL_Adapter_AdapterInfo_Get) \
+    F(ADL_ADAPTER_ACTIVE_GET, ADL_Adapter_Active_Get) \
+    F(ADL_ADAPTER_ID_GET, ADL_Adapter_ID_Get) \
+    F(ADL_ADAPTER_VIDEOBIOSINFO_GET, ADL_Adapter_VideoBiosInfo_Get) \
+    F(ADL_OVERDRIVE_CAPS, ADL_Overdrive_Caps) \
+    F(ADL_OVERDRIVE5_THERMALDEVICES_ENUM, ADL_Overdrive5_ThermalDevices_Enum) \
+    F(ADL_OVERDRIVE5_ODPARAMETERS_GET, ADL_Overdrive5_ODParameters_Get) \
+    F(ADL_OVERDRIVE5_TEMPERATURE_GET, ADL_Overdrive5_Temperature_Get) \
+    F(ADL_OVERDRIVE5_FANSPEED_GET, ADL_Overdrive5_FanSpeed_Get) \
+    F(ADL_OVERDRIVE5_FANSPEEDINFO_GET, ADL_Overdrive5_FanSpeedInfo_Get) \
+    F(ADL_OVERDRIVE5_ODPERFORMANCELEVELS_GET, ADL_Overdrive5_ODPerformanceLevels_Get) \
+    F(ADL_OVERDRIVE5_CURRENTACTIVITY_GET, ADL_Overdrive5_CurrentActivity_Get) \
+    F(ADL_OVERDRIVE5_FANSPEED_SET, ADL_Overdrive5_FanSpeed_Set) \
+    F(ADL_OVERDRIVE5_FANSPEEDTODEFAULT_SET, ADL_Overdrive5_FanSpeedToDefault_Set) \
+    F(ADL_OVERDRIVE5_ODPERFORMANCELEVELS_SET, ADL_Overdrive5_ODPerformanceLevels_Set) \
+    F(ADL_OVERDRIVE5_POWERCONTROL_CAPS, ADL_Overdrive5_PowerControl_Caps) \
+    F(ADL_OVERDRIVE5_POWERCONTROLINFO_GET, ADL_Overdrive5_PowerControlInfo_Get) \
+    F(ADL_OVERDRIVE5_POWERCONTROL_GET, ADL_Overdrive5_PowerControl_Get) \
+    F(ADL_OVERDRIVE5_POWERCONTROL_SET, ADL_Overdrive5_PowerControl_Set) \
+    F(ADL_OVERDRIVE6_FANSPEED_GET, ADL_Overdrive6_FanSpeed_Get) \
+    F(ADL_OVERDRIVE6_THERMALCONTROLLER_CAPS, ADL_Overdrive6_ThermalController_Caps) \
+    F(ADL_OVERDRIVE6_TEMPERATURE_GET, ADL_Overdrive6_Temperature_Get) \
+    F(ADL_OVERDRIVE6_CAPABILITIES_GET, ADL_Overdrive6_Capabilities_Get) \
+    F(ADL_OVERDRIVE6_STATEINFO_GET, ADL_Overdrive6_StateInfo_Get) \
+    F(ADL_OVERDRIVE6_CURRENTSTATUS_GET, ADL_Overdrive6_CurrentStatus_Get) \
+    F(ADL_OVERDRIVE6_POWERCONTROL_CAPS, ADL_Overdrive6_PowerControl_Caps) \
+    F(ADL_OVERDRIVE6_POWERCONTROLINFO_GET, ADL_Overdrive6_PowerControlInfo_Get) \
+    F(ADL_OVERDRIVE6_POWERCONTROL_GET, ADL_Overdrive6_PowerControl_Get) \
+    F(ADL_OVERDRIVE6_FANSPEED_SET, ADL_Overdrive6_FanSpeed_Set) \
+    F(ADL_OVERDRIVE6_STATE_SET, ADL_Overdrive6_State_Set) \
+    F(ADL_OVERDRIVE6_POWERCONTROL_SET, ADL_Overdrive6_PowerControl_Set)
+
+namespace ADLFunction {
+    enum Id {
+#define QTAMD_ADL_FUNCTION_ID(type, name) name,
+        QTAMD_ADL_FUNCTIONS(QTAMD_ADL_FUNCTION_ID)
+#undef QTAMD_ADL_FUNCTION_ID
+        NumberOfFunctions
+    };
+}
+
+Q_STATIC_ASSERT(ADLFunction::NumberOfFunctions <= 64);
+
+// The ADL2 twin of a legacy entry point type, which takes the context
+// handle as its first argument.
+template<typename Function> struct ADL2Function;
+template<typename... Parameters> struct ADL2Function<int (*)(Parameters...)> {
+    typedef int (*Type)(ADL_CONTEXT_HANDLE, Parameters...);
+};
+
+inline void *loadFunction(void *dll, const char *name) {
 #if defined Q_OS_LINUX
     return dlsym(dll, name);
 #else
@@ -67,13 +125,82 @@ void *loadFunction(void *dll, const char *name) {
 #endif
 }
 
-#define ADL(dll, type, name) type name = (type) loadFunction(dll, #name);
+/**
+ * Function pointers to all ADL entry points, resolved once when the library
+ * is loaded. Bit n of `available` is set if the function with id n exists.
+ * The ADL2 twins, e.g. ADL2_Overdrive5_Temperature_Get, are kept by id in
+ * `adl2` and flagged in `adl2Available`. ADL2_Main_Control_Create takes
+ * different arguments and is kept on its own.
+ */
+struct ADLFunctionTable {
+#define QTAMD_ADL_FUNCTION_POINTER(type, name) type name;
+    QTAMD_ADL_FUNCTIONS(QTAMD_ADL_FUNCTION_POINTER)
+#undef QTAMD_ADL_FUNCTION_POINTER
 
+    quint64 available;
 
-void functionNotAvailable(const char *name) {
-    qDebug() << "QtAMD: The function" << name << "is not available.";
-}
+    ADL2_MAIN_CONTROL_CREATE ADL2_Main_Control_Create;
+    void *adl2[ADLFunction::NumberOfFunctions];
+    quint64 adl2Available;
 
-void functionCallFailed(const char *name, int errorCode) {
-    qDebug() << "QtAMD: Calling the function" << name << "failed with error code" << errorCode << ".";
-}
+    ADLFunctionTable() {
+        clear();
+    }
+
+    void clear() {
+#define QTAMD_ADL_FUNCTION_CLEAR(type, name) name = 0;
+        QTAMD_ADL_FUNCTIONS(QTAMD_ADL_FUNCTION_CLEAR)
+#undef QTAMD_ADL_FUNCTION_CLEAR
+        available = 0;
+
+        ADL2_Main_Control_Create = 0;
+        memset(adl2, 0, sizeof(adl2));
+        adl2Available = 0;
+    }
+
+    void resolve(void *dll) {
+        clear();
+        if(!dll) { return; }
+#define QTAMD_ADL_FUNCTION_RESOLVE(type, name) \
+        name = (type) loadFunction(dll, #name); \
+        if(name) { \
+            available |= Q_UINT64_C(1) << ADLFunction::name; \
+        }
+        QTAMD_ADL_FUNCTIONS(QTAMD_ADL_FUNCTION_RESOLVE)
+#undef QTAMD_ADL_FUNCTION_RESOLVE
+
+        ADL2_Main_Control_Create = (ADL2_MAIN_CONTROL_CREATE) loadFunction(dll, "ADL2_Main_Control_Create");
+        for(int id = 0; id < ADLFunction::NumberOfFunctions; id++) {
+            if(id == ADLFunction::ADL_Main_Control_Create) { continue; }
+            // "ADL_Foo" becomes "ADL2_Foo".
+            char adl2Name[64];
+            snprintf(adl2Name, sizeof(adl2Name), "ADL2%s", name((ADLFunction::Id)id) + 3);
+            adl2[id] = loadFunction(dll, adl2Name);
+            if(adl2[id]) {
+                adl2Available |= Q_UINT64_C(1) << id;
+            }
+        }
+    }
+
+    bool has(ADLFunction::Id id) const {
+        return available & (Q_UINT64_C(1) << id);
+    }
+
+    bool hasADL2(ADLFunction::Id id) const {
+        return adl2Available & (Q_UINT64_C(1) << id);
+    }
+
+    // Whether independent ADL2 contexts can be created and destroyed.
+    bool supportsADL2() const {
+        return ADL2_Main_Control_Create && hasADL2(ADLFunction::ADL_Main_Control_Destroy);
+    }
+
+    static const char *name(ADLFunction::Id id) {
+        static const char *names[] = {
+#define QTAMD_ADL_FUNCTION_NAME(type, name) #name,
+            QTAMD_ADL_FUNCTIONS(QTAMD_ADL_FUNCTION_NAME)
+#undef QTAMD_ADL_FUNCTION_NAME
+        };
+        return (id >= 0 && id < ADLFunction::NumberOfFunctions) ? names[id] : "";
+    }
+};
@@ -0,0 +1,212 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+//    This file is part of QtAMD.                                            //
+//    Copyright (C) 2015-2016 Jacob Dawid, jacob@omg-it.works                //
+//                                                                           //
+//    QtAMD is free software: you can redistribute it and/or modify          //
+//    it under the terms of the GNU Affero General Public License as         //
+//    published by the Free Software Foundation, either version 3 of the     //
+//    License, or (at your option) any later version.                        //
+//                                                                           //
+//    QtAMD is distributed in the hope that it will be useful,               //
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of         //
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          //
+//    GNU Affero General Public License for more details.                    //
+//                                                                           //
+//    You should have received a copy of the GNU General Public License      //
+//    along with QtAMD. If not, see <http://www.gnu.org/licenses/>.          //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "adlmemory.h"
+
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+
+// Stored in front of every buffer, so it can be counted and handed back to
+// the allocator it came from.
+struct Header {
+    ADLMemory::FreeFunction free;
+    void *userData;
+    qint64 size;
+};
+
+// Keeps the buffers behind the header aligned like malloc's.
+const int alignment = 16;
+const int headerSize = (sizeof(Header) + alignment - 1) & ~(alignment - 1);
+
+struct Arena {
+    // ArenaSize bytes from malloc, allocated on first use.
+    char *buffer;
+    int offset;
+    int liveAllocations;
+
+    bool contains(const char *block) const {
+        return buffer && block >= buffer && block < buffer + ADLMemory::ArenaSize;
+    }
+};
+
+QMutex mutex;
+Arena arena = { 0, 0, 0 };
+// Set aside by retireArena() while they still held buffers.
+QList<Arena> retiredArenas;
+ADLMemory::Counters counters = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+ADLMemory::Allocator currentAllocator = ADLMemory::arenaAllocator();
+
+}
+
+void ADLMemory::setAllocator(const Allocator& allocator) {
+    QMutexLocker locker(&mutex);
+    currentAllocator = allocator;
+}
+
+ADLMemory::Allocator ADLMemory::allocator() {
+    QMutexLocker locker(&mutex);
+    return currentAllocator;
+}
+
+ADLMemory::Allocator ADLMemory::arenaAllocator() {
+    Allocator allocator = { arenaAllocate, arenaFree, 0 };
+    return allocator;
+}
+
+ADLMemory::Allocator ADLMemory::heapAllocator() {
+    Allocator allocator = { heapAllocate, heapFree, 0 };
+    return allocator;
+}
+
+ADLMemory::Counters ADLMemory::counters() {
+    QMutexLocker locker(&mutex);
+    return ::counters;
+}
+
+void ADLMemory::resetCounters() {
+    QMutexLocker locker(&mutex);
+    // Outstanding buffers are still outstanding.
+    qint64 outstandingAllocations = ::counters.outstandingAllocations;
+    qint64 outstandingBytes = ::counters.outstandingBytes;
+    memset(&::counters, 0, sizeof(Counters));
+    ::counters.outstandingAllocations = outstandingAllocations;
+    ::counters.outstandingBytes = outstandingBytes;
+    ::counters.peakOutstandingBytes = outstandingBytes;
+    ::counters.retiredArenas = retiredArenas.size();
+}
+
+void *ADLMemory::allocate(int size) {
+    QMutexLocker locker(&mutex);
+    if(size < 0) {
+        ::counters.failedAllocations++;
+        return 0;
+    }
+
+    char *block = (char*)currentAllocator.allocate(headerSize + size, currentAllocator.userData);
+    if(!block) {
+        ::counters.failedAllocations++;
+        return 0;
+    }
+
+    Header *header = (Header*)block;
+    header->free = currentAllocator.free;
+    header->userData = currentAllocator.userData;
+    header->size = size;
+
+    ::counters.allocations++;
+    ::counters.bytes += size;
+    ::counters.outstandingAllocations++;
+    ::counters.outstandingBytes += size;
+    if(::counters.outstandingBytes > ::counters.peakOutstandingBytes) {
+        ::counters.peakOutstandingBytes = ::counters.outstandingBytes;
+    }
+    return block + headerSize;
+}
+
+void ADLMemory::free(void *buffer) {
+    if(!buffer) {
+        return;
+    }
+
+    QMutexLocker locker(&mutex);
+    Header *header = (Header*)((char*)buffer - headerSize);
+    ::counters.frees++;
+    ::counters.outstandingAllocations--;
+    ::counters.outstandingBytes -= header->size;
+    header->free(header, header->userData);
+}
+
+void ADLMemory::retireArena() {
+    QMutexLocker locker(&mutex);
+    if(arena.liveAllocations == 0) {
+        if(arena.offset > 0) {
+            arena.offset = 0;
+            ::counters.arenaRewinds++;
+        }
+        return;
+    }
+
+    retiredArenas.append(arena);
+    ::counters.retiredArenas = retiredArenas.size();
+    arena.buffer = 0;
+    arena.offset = 0;
+    arena.liveAllocations = 0;
+}
+
+// Called with the mutex held.
+void *ADLMemory::arenaAllocate(int size, void *userData) {
+    if(!arena.buffer) {
+        arena.buffer = (char*)malloc(ArenaSize);
+    }
+    int alignedSize = (size + alignment - 1) & ~(alignment - 1);
+    if(!arena.buffer || alignedSize > ArenaSize - arena.offset) {
+        ::counters.arenaOverflows++;
+        return heapAllocate(size, userData);
+    }
+
+    void *block = arena.buffer + arena.offset;
+    arena.offset += alignedSize;
+    arena.liveAllocations++;
+    ::counters.arenaAllocations++;
+    return block;
+}
+
+// Called with the mutex held.
+void ADLMemory::arenaFree(void *buffer, void *userData) {
+    char *block = (char*)buffer;
+    if(!arena.contains(block)) {
+        for(int i = 0; i < retiredArenas.size(); i++) {
+            Arena& retired = retiredArenas[i];
+            if(retired.contains(block)) {
+                retired.liveAllocations--;
+                if(retired.liveAllocations == 0) {
+                    ::free(retired.buffer);
+                    retiredArenas.removeAt(i);
+                    ::counters.retiredArenas = retiredArenas.size();
+                }
+                return;
+            }
+        }
+        heapFree(buffer, userData);
+        return;
+    }
+
+    arena.liveAllocations--;
+    if(arena.liveAllocations == 0) {
+        arena.offset = 0;
+        ::counters.arenaRewinds++;
+    }
+}
+
+void *ADLMemory::heapAllocate(int size, void *userData) {
+    Q_UNUSED(userData);
+    return malloc(size);
+}
+
+void ADLMemory::heapFree(void *buffer, void *userData) {
+    Q_UNUSED(userData);
+    ::free(buffer);
+}
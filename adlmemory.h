@@ -0,0 +1,98 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+//    This file is part of QtAMD.                                            //
+//    Copyright (C) 2015-2016 Jacob Dawid, jacob@omg-it.works                //
+//                                                                           //
+//    QtAMD is free software: you can redistribute it and/or modify          //
+//    it under the terms of the GNU Affero General Public License as         //
+//    published by the Free Software Foundation, either version 3 of the     //
+//    License, or (at your option) any later version.                        //
+//                                                                           //
+//    QtAMD is distributed in the hope that it will be useful,               //
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of         //
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          //
+//    GNU Affero General Public License for more details.                    //
+//                                                                           //
+//    You should have received a copy of the GNU General Public License      //
+//    along with QtAMD. If not, see <http://www.gnu.org/licenses/>.          //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <QtGlobal>
+
+/**
+ * Memory ADL allocates through the ADL_Main_Memory_Alloc callback passed to
+ * ADL_Main_Control_Create. The callback has no context argument, so the
+ * allocator is process-wide. By default buffers come from a small bump
+ * arena, which is rewound as soon as all of its buffers have been freed
+ * again, and from the heap once the arena is full. Every allocation is
+ * counted, so buffers that are never freed show up as outstanding.
+ *
+ * A buffer ADL never frees would keep the arena from ever rewinding, so
+ * every time an ADL context is destroyed an arena still holding buffers is
+ * set aside, and released once they have been freed, and allocations
+ * continue in a fresh one.
+ *
+ * Buffers start behind a header and may live in the arena, so they must
+ * only be released with ADL_Main_Memory_Free() or free() below, never with
+ * the C library's free().
+ */
+class ADLMemory {
+public:
+    typedef void *(*AllocateFunction)(int size, void *userData);
+    typedef void (*FreeFunction)(void *buffer, void *userData);
+
+    struct Allocator {
+        AllocateFunction allocate;
+        FreeFunction free;
+        void *userData;
+    };
+
+    struct Counters {
+        quint64 allocations;
+        quint64 bytes;
+        quint64 frees;
+        quint64 failedAllocations;
+        // Allocations still waiting for ADL_Main_Memory_Free.
+        qint64 outstandingAllocations;
+        qint64 outstandingBytes;
+        qint64 peakOutstandingBytes;
+        // Only used by the default arena allocator.
+        quint64 arenaAllocations;
+        quint64 arenaOverflows;
+        quint64 arenaRewinds;
+        // Arenas set aside by retireArena() whose buffers aren't all freed.
+        qint64 retiredArenas;
+    };
+
+    enum {
+        ArenaSize = 64 * 1024
+    };
+
+    // Buffers allocated before the allocator is changed are still freed
+    // by the allocator they came from. Allocators are called with a lock
+    // held and must not call back into ADLMemory.
+    static void setAllocator(const Allocator& allocator);
+    static Allocator allocator();
+    static Allocator arenaAllocator();
+    static Allocator heapAllocator();
+
+    static Counters counters();
+    static void resetCounters();
+
+    static void *allocate(int size);
+    static void free(void *buffer);
+
+    // Called after an ADL context has been destroyed. Rewinds the arena if
+    // it is empty, and otherwise sets it aside until its buffers are freed
+    // and continues in a new one.
+    static void retireArena();
+
+private:
+    static void *arenaAllocate(int size, void *userData);
+    static void arenaFree(void *buffer, void *userData);
+    static void *heapAllocate(int size, void *userData);
+    static void heapFree(void *buffer, void *userData);
+};
@@ -0,0 +1,77 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+//    This file is part of QtAMD.                                            //
+//    Copyright (C) 2015-2016 Jacob Dawid, jacob@omg-it.works                //
+//                                                                           //
+//    QtAMD is free software: you can redistribute it and/or modify          //
+//    it under the terms of the GNU Affero General Public License as         //
+//    published by the Free Software Foundation, either version 3 of the     //
+//    License, or (at your option) any later version.                        //
+//                                                                           //
+//    QtAMD is distributed in the hope that it will be useful,               //
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of         //
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          //
+//    GNU Affero General Public License for more details.                    //
+//                                                                           //
+//    You should have received a copy of the GNU General Public License      //
+//    along with QtAMD. If not, see <http://www.gnu.org/licenses/>.          //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include "adl/adl_defines.h"
+
+// Returned by ADL_Overdrive5_ThermalDevices_Enum past the last thermal
+// controller. Newer ADL SDKs define it, older ones don't.
+#ifndef ADL_WARNING_NO_DATA
+#define ADL_WARNING_NO_DATA                 -100
+#endif
+
+// QtAMD's own return codes, in addition to the ADL_ERR_* codes.
+#define QTAMD_ERR_FUNCTION_NOT_AVAILABLE    -1000   ///< The ADL library doesn't export the function.
+#define QTAMD_ERR_CIRCUIT_OPEN              -1001   ///< The function kept failing on this adapter and is not called for now.
+#define QTAMD_ERR_OUT_OF_RANGE              -1002   ///< The value is outside of the range the adapter accepts.
+
+/**
+ * Value returned by an ADL call, together with the call's return code.
+ * If the call failed, the value is default constructed.
+ */
+template<typename T>
+class ADLResult {
+public:
+    ADLResult()
+        : _value(),
+          _returnCode(ADL_ERR) {
+    }
+
+    ADLResult(const T& value, int returnCode = ADL_OK)
+        : _value(value),
+          _returnCode(returnCode) {
+    }
+
+    static ADLResult failure(int returnCode) {
+        return ADLResult(T(), returnCode);
+    }
+
+    bool ok() const {
+        return _returnCode == ADL_OK;
+    }
+
+    int returnCode() const {
+        return _returnCode;
+    }
+
+    const T& value() const {
+        return _value;
+    }
+
+    T valueOr(const T& fallback) const {
+        return ok() ? _value : fallback;
+    }
+
+private:
+    T _value;
+    int _returnCode;
+};
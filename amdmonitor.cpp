@@ -0,0 +1,187 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+//    This file is part of QtAMD.                                            //
+//    Copyright (C) 2015-2016 Jacob Dawid, jacob@omg-it.works                //
+//                                                                           //
+//    QtAMD is free software: you can redistribute it and/or modify          //
+//    it under the terms of the GNU Affero General Public License as         //
+//    published by the Free Software Foundation, either version 3 of the     //
+//    License, or (at your option) any later version.                        //
+//                                                                           //
+//    QtAMD is distributed in the hope that it will be useful,               //
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of         //
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          //
+//    GNU Affero General Public License for more details.                    //
+//                                                                           //
+//    You should have received a copy of the GNU General Public License      //
+//    along with QtAMD. If not, see <http://www.gnu.org/licenses/>.          //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "amdmonitor.h"
+
+#include <string.h>
+
+AMDMonitor::AMDMonitor(int intervalMilliseconds, QObject *parent, const QString& libraryPath)
+    : QObject(parent),
+      _overdrive(libraryPath),
+      _timer(this) {
+    qRegisterMetaType<AMDMonitor::Change>("AMDMonitor::Change");
+    qRegisterMetaType<QVector<AMDMonitor::Change> >("QVector<AMDMonitor::Change>");
+
+    _deadbands[Temperature] = 1000;
+    _deadbands[Activity] = 1;
+    _deadbands[EngineClock] = 100;
+    _deadbands[MemoryClock] = 100;
+    _deadbands[FanSpeedRpm] = 50;
+    _deadbands[FanSpeedPercent] = 1;
+    _deadbands[PowerControl] = 1;
+
+    // Allocate everything up front, so polling doesn't allocate.
+    int numberOfAdapters = _overdrive.activeGpus().size();
+    _snapshot.adapters.resize(numberOfAdapters);
+    _reported.resize(numberOfAdapters);
+    memset(_reported.data(), 0, sizeof(AMDOverdrive::AdapterSample) * numberOfAdapters);
+    _changes.reserve(numberOfAdapters);
+
+    _timer.setInterval(qMax(intervalMilliseconds, 1));
+    connect(&_timer, &QTimer::timeout, this, &AMDMonitor::poll);
+}
+
+AMDMonitor::~AMDMonitor() {
+}
+
+void AMDMonitor::setInterval(int milliseconds) {
+    _timer.setInterval(qMax(milliseconds, 1));
+}
+
+int AMDMonitor::interval() const {
+    return _timer.interval();
+}
+
+void AMDMonitor::setDeadband(Quantity quantity, int deadband) {
+    if(quantity >= 0 && quantity < NumberOfQuantities) {
+        _deadbands[quantity] = qMax(deadband, 0);
+    }
+}
+
+int AMDMonitor::deadband(Quantity quantity) const {
+    return (quantity >= 0 && quantity < NumberOfQuantities) ? _deadbands[quantity] : 0;
+}
+
+const QVector<int>& AMDMonitor::adapters() const {
+    return _overdrive.activeGpus();
+}
+
+AMDOverdrive::AdapterSample AMDMonitor::reportedSample(int adapterIndex) const {
+    int index = _overdrive.activeGpus().indexOf(_overdrive.gpuAdapterIndex(adapterIndex));
+    if(index >= 0 && index < _reported.size()) {
+        return _reported.at(index);
+    }
+    AMDOverdrive::AdapterSample sample;
+    memset(&sample, 0, sizeof(AMDOverdrive::AdapterSample));
+    return sample;
+}
+
+bool AMDMonitor::isActive() const {
+    return _timer.isActive();
+}
+
+void AMDMonitor::start() {
+    _timer.start();
+}
+
+void AMDMonitor::stop() {
+    _timer.stop();
+}
+
+bool AMDMonitor::hasMoved(Quantity quantity, bool valid, bool known, int value, int reported) const {
+    if(!valid) {
+        return false;
+    }
+    // A quantity seen for the first time is always reported.
+    if(!known) {
+        return true;
+    }
+    int distance = qAbs(value - reported);
+    return distance > 0 && distance >= _deadbands[quantity];
+}
+
+void AMDMonitor::poll() {
+    _overdrive.snapshot(_snapshot);
+    _reported.resize(_snapshot.adapters.size());
+    _changes.resize(0);
+
+    for(int i = 0; i < _snapshot.adapters.size(); i++) {
+        const AMDOverdrive::AdapterSample& sample = _snapshot.adapters.at(i);
+        AMDOverdrive::AdapterSample& reported = _reported[i];
+        int known = reported.validFields;
+        int quantities = 0;
+
+        if(hasMoved(Temperature, sample.validFields & AMDOverdrive::TemperatureField, known & AMDOverdrive::TemperatureField,
+                    sample.temperatureMillidegreesCelsius, reported.temperatureMillidegreesCelsius)) {
+            reported.temperatureMillidegreesCelsius = sample.temperatureMillidegreesCelsius;
+            quantities |= 1 << Temperature;
+        }
+        if(hasMoved(Activity, sample.validFields & AMDOverdrive::ActivityField, known & AMDOverdrive::ActivityField,
+                    sample.activity.iActivityPercent, reported.activity.iActivityPercent)) {
+            reported.activity.iActivityPercent = sample.activity.iActivityPercent;
+            quantities |= 1 << Activity;
+        }
+        if(hasMoved(EngineClock, sample.validFields & AMDOverdrive::ActivityField, known & AMDOverdrive::ActivityField,
+                    sample.activity.iEngineClock, reported.activity.iEngineClock)) {
+            reported.activity.iEngineClock = sample.activity.iEngineClock;
+            quantities |= 1 << EngineClock;
+        }
+        if(hasMoved(MemoryClock, sample.validFields & AMDOverdrive::ActivityField, known & AMDOverdrive::ActivityField,
+                    sample.activity.iMemoryClock, reported.activity.iMemoryClock)) {
+            reported.activity.iMemoryClock = sample.activity.iMemoryClock;
+            quantities |= 1 << MemoryClock;
+        }
+        if(hasMoved(FanSpeedRpm, sample.validFields & AMDOverdrive::FanSpeedRpmField, known & AMDOverdrive::FanSpeedRpmField,
+                    sample.fanSpeedRpm, reported.fanSpeedRpm)) {
+            reported.fanSpeedRpm = sample.fanSpeedRpm;
+            quantities |= 1 << FanSpeedRpm;
+        }
+        if(hasMoved(FanSpeedPercent, sample.validFields & AMDOverdrive::FanSpeedPercentField, known & AMDOverdrive::FanSpeedPercentField,
+                    sample.fanSpeedPercent, reported.fanSpeedPercent)) {
+            reported.fanSpeedPercent = sample.fanSpeedPercent;
+            quantities |= 1 << FanSpeedPercent;
+        }
+        if(hasMoved(PowerControl, sample.validFields & AMDOverdrive::PowerControlField, known & AMDOverdrive::PowerControlField,
+                    sample.powerControl, reported.powerControl)) {
+            reported.powerControl = sample.powerControl;
+            quantities |= 1 << PowerControl;
+        }
+
+        if(quantities == 0) {
+            continue;
+        }
+        reported.adapterIndex = sample.adapterIndex;
+        reported.timestamp = sample.timestamp;
+        reported.validFields |= sample.validFields & ~AMDOverdrive::PerformanceLevelsField;
+
+        if(quantities & (1 << Temperature)) {
+            emit temperatureChanged(sample.adapterIndex, reported.temperatureMillidegreesCelsius);
+        }
+        if(quantities & (1 << Activity)) {
+            emit activityChanged(sample.adapterIndex, reported.activity.iActivityPercent);
+        }
+        if(quantities & ((1 << EngineClock) | (1 << MemoryClock))) {
+            emit clocksChanged(sample.adapterIndex, reported.activity.iEngineClock, reported.activity.iMemoryClock);
+        }
+        if(quantities & ((1 << FanSpeedRpm) | (1 << FanSpeedPercent))) {
+            emit fanSpeedChanged(sample.adapterIndex, reported.fanSpeedRpm, reported.fanSpeedPercent);
+        }
+        if(quantities & (1 << PowerControl)) {
+            emit powerControlChanged(sample.adapterIndex, reported.powerControl);
+        }
+
+        Change change = { sample.adapterIndex, quantities };
+        _changes.append(change);
+    }
+
+    if(!_changes.isEmpty()) {
+        emit changed(_changes);
+    }
+}
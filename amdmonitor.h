@@ -0,0 +1,113 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+//    This file is part of QtAMD.                                            //
+//    Copyright (C) 2015-2016 Jacob Dawid, jacob@omg-it.works                //
+//                                                                           //
+//    QtAMD is free software: you can redistribute it and/or modify          //
+//    it under the terms of the GNU Affero General Public License as         //
+//    published by the Free Software Foundation, either version 3 of the     //
+//    License, or (at your option) any later version.                        //
+//                                                                           //
+//    QtAMD is distributed in the hope that it will be useful,               //
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of         //
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          //
+//    GNU Affero General Public License for more details.                    //
+//                                                                           //
+//    You should have received a copy of the GNU General Public License      //
+//    along with QtAMD. If not, see <http://www.gnu.org/licenses/>.          //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <QObject>
+#include <QTimer>
+#include <QVector>
+#include <QMetaType>
+
+#include "amdoverdrive.h"
+
+/**
+ * Polls all active GPUs at a fixed interval and only tells about values
+ * that moved by more than their deadband since they were last reported.
+ * Per-adapter signals are emitted for every such change, followed by a
+ * single changed() signal for the whole sweep, so a view connected to
+ * changed() repaints at most once per tick however many GPUs there are.
+ *
+ * Polling calls the driver on the monitor's thread; move the monitor to a
+ * worker thread to keep the driver away from the GUI thread.
+ */
+class AMDMonitor : public QObject {
+    Q_OBJECT
+
+public:
+    enum Quantity {
+        Temperature,
+        Activity,
+        EngineClock,
+        MemoryClock,
+        FanSpeedRpm,
+        FanSpeedPercent,
+        PowerControl,
+        NumberOfQuantities
+    };
+
+    struct Change {
+        int adapterIndex;
+        // Bit n is set if Quantity n changed.
+        int quantities;
+    };
+
+    AMDMonitor(int intervalMilliseconds = 1000, QObject *parent = 0, const QString& libraryPath = QString());
+    ~AMDMonitor();
+
+    void setInterval(int milliseconds);
+    int interval() const;
+
+    // Smallest change that is reported, in the quantity's unit:
+    // millidegrees Celsius, percent, 10 kHz, rpm, or the power control
+    // value. Defaults to 1 degree, 1 percent, 1 MHz, 50 rpm and 1. A
+    // deadband of 0 reports every change.
+    void setDeadband(Quantity quantity, int deadband);
+    int deadband(Quantity quantity) const;
+
+    // GPUs being polled, one adapter index each.
+    const QVector<int>& adapters() const;
+    // The values last reported for adapterIndex, e.g. to fill a view
+    // after connecting. Zeroed if the adapter is unknown.
+    AMDOverdrive::AdapterSample reportedSample(int adapterIndex) const;
+
+    bool isActive() const;
+
+public slots:
+    void start();
+    void stop();
+    // Polls once, right now.
+    void poll();
+
+signals:
+    void temperatureChanged(int adapterIndex, int millidegreesCelsius);
+    void activityChanged(int adapterIndex, int activityPercent);
+    void clocksChanged(int adapterIndex, int engineClock, int memoryClock);
+    void fanSpeedChanged(int adapterIndex, int rpm, int percent);
+    void powerControlChanged(int adapterIndex, int value);
+    // Once per sweep that changed anything, after the signals above.
+    void changed(const QVector<AMDMonitor::Change>& changes);
+
+private:
+    // Whether value moved far enough from the reported one to report it.
+    bool hasMoved(Quantity quantity, bool valid, bool known, int value, int reported) const;
+
+    AMDOverdrive _overdrive;
+    AMDOverdrive::RigSnapshot _snapshot;
+    QTimer _timer;
+    int _deadbands[NumberOfQuantities];
+
+    // Last reported values, in snapshot order. validFields has the fields
+    // that have been reported at least once.
+    QVector<AMDOverdrive::AdapterSample> _reported;
+    QVector<Change> _changes;
+};
+
+Q_DECLARE_METATYPE(AMDMonitor::Change)
+Q_DECLARE_METATYPE(QVector<AMDMonitor::Change>)
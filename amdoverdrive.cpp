@@ -19,480 +19,506 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "amdoverdrive.h"
+#include "overdrivebackend.h"
+#include "adaptertopology.h"
 
 #include <stdio.h>
+#include <algorithm>
+
+#include <QDateTime>
+#include <QDataStream>
+#include <QFile>
+#include <QSaveFile>
 
 #define AMDVENDORID             (1002)
-#define ADL_WARNING_NO_DATA      -100
+
+// Header of the metadata file.
+static const quint32 metadataMagic = 0x51414d44;
+static const quint16 metadataVersion = 1;
 
 #include "adlfunctionpointers.h"
+#include "adlcontext.h"
 
-void* __stdcall ADL_Main_Memory_Alloc(int iSize) {
-    void* lpBuffer = malloc(iSize);
-    return lpBuffer;
+AMDOverdrive::AMDOverdrive(QString libraryPath, ContextMode mode)
+    : AMDOverdrive(QSharedPointer<const AdapterTopology>(), libraryPath, mode) {
 }
 
-void __stdcall ADL_Main_Memory_Free(void** lpBuffer) {
-    if (NULL != *lpBuffer) {
-        free(*lpBuffer);
-        *lpBuffer = NULL;
+AMDOverdrive::AMDOverdrive(QSharedPointer<const AdapterTopology> topology, QString libraryPath, ContextMode mode)
+    : _contextMode(mode),
+      _adl2Context(0),
+      _overdrive5Backend(0),
+      _overdrive6Backend(0),
+      _unsupportedBackend(0),
+      _loggingEnabled(false),
+      _logIntervalMilliseconds(10000),
+      _circuitBreakerThreshold(3),
+      _initialBackoffMilliseconds(1000),
+      _maximumBackoffMilliseconds(300000) {
+    memset(_errors, 0, sizeof(_errors));
+    memset(&_writeCounters, 0, sizeof(WriteCounters));
+    _topology = QSharedPointer<const AdapterTopology>(new AdapterTopology());
+    _clock.start();
+
+    // Allow running against another ADL implementation, e.g. the mock library.
+    if(libraryPath.isEmpty()) {
+        libraryPath = QString::fromLocal8Bit(qgetenv("QTAMD_ADL_LIBRARY"));
     }
-}
 
-AMDOverdrive::AMDOverdrive() {
-#if defined Q_OS_LINUX
-    _dll = dlopen("libatiadlxx.so", RTLD_LAZY | RTLD_GLOBAL);
-#else
-    _dll = LoadLibrary("atiadlxx.dll");
-    if(_dll == NULL)
-        // A 32 bit calling application on 64 bit OS will fail to LoadLibrary.
-        // Try to load the 32 bit library (atiadlxy.dll) instead
-        _dll = LoadLibrary("atiadlxy.dll");
-#endif
+    // AMDOverdrive objects using the same library share one ADL context.
+    _context = ADLContext::acquire(libraryPath);
+    _contextGeneration = _context->generation();
+    _adl = _context->functions();
+    _overdrive5Backend = new Overdrive5Backend(*this, _adl);
+    _overdrive6Backend = new Overdrive6Backend(*this, _adl);
+    _unsupportedBackend = new UnsupportedOverdriveBackend(*this);
 
-    if(_dll) {
-        ADL(_dll, ADL_MAIN_CONTROL_CREATE, ADL_Main_Control_Create)
-        if(ADL_Main_Control_Create) {
-            int returnCode = ADL_Main_Control_Create(ADL_Main_Memory_Alloc, 1);
-            if(returnCode == ADL_OK) {
-
-            } else {
-                functionCallFailed("ADL_Main_Control_Create", returnCode);
-            }
-        } else {
-            functionNotAvailable("ADL_Main_Control_Create");
+    if(!_adl.supportsADL2()) {
+        _contextMode = GlobalContext;
+    }
+    if(_contextMode == PrivateContext) {
+        int returnCode;
+        _adl2Context = _context->createPrivateContext(&returnCode);
+        if(!_adl2Context) {
+            reportFailure(ADLFunction::ADL_Main_Control_Create, returnCode);
         }
+    }
+
+    if(isInitialized() && topology) {
+        adoptTopology(topology);
+    } else if(isInitialized()) {
+        refreshAdapters();
+    } else if(_context->isLoaded() && _contextMode == GlobalContext) {
+        reportFailure(ADLFunction::ADL_Main_Control_Create, _context->initializationResult());
+    }
+}
+
+AMDOverdrive::~AMDOverdrive() {
+    _context->destroyPrivateContext(_adl2Context);
+    delete _overdrive5Backend;
+    delete _overdrive6Backend;
+    delete _unsupportedBackend;
+}
+
+int AMDOverdrive::reinitialize() {
+    int returnCode;
+    if(_contextMode == PrivateContext) {
+        // Without a context calls fail until the next reinitialize(), they
+        // never fall back to the global context.
+        _context->destroyPrivateContext(_adl2Context);
+        _adl2Context = _context->createPrivateContext(&returnCode);
     } else {
-        qDebug() << "AMDOverdrive: libatiadlxx.so/atiadlxx.dll/atiadlxy.dll not found.";
+        returnCode = _context->reinitialize(_contextGeneration);
+        _contextGeneration = _context->generation();
+    }
+    if(returnCode != ADL_OK) {
+        return reportFailure(ADLFunction::ADL_Main_Control_Create, returnCode);
+    }
+
+    // Nothing known about the driver from before the reset is trusted.
+    forgetWrittenValues();
+    resetCircuitBreakers();
+    refreshAdapters();
+    refreshMetadata();
+    return ADL_OK;
+}
+
+bool AMDOverdrive::isInitialized() const {
+    if(_contextMode == PrivateContext) {
+        return _adl2Context != 0;
     }
+    return _context->isInitialized();
 }
 
-int AMDOverdrive::numberOfAdapters() {
-    if(!_dll) { return -1; }
+int AMDOverdrive::contextGeneration() const {
+    return _contextGeneration;
+}
 
-    ADL(_dll, ADL_ADAPTER_NUMBEROFADAPTERS_GET, ADL_Adapter_NumberOfAdapters_Get)
+AMDOverdrive::ContextMode AMDOverdrive::contextMode() const {
+    return _contextMode;
+}
 
-    if(ADL_Adapter_NumberOfAdapters_Get) {
-        int n, returnCode;
-        returnCode = ADL_Adapter_NumberOfAdapters_Get(&n);
-        if(returnCode == ADL_OK) {
-            return n;
-        } else {
-            functionCallFailed("ADL_Adapter_NumberOfAdapters_Get", returnCode);
+bool AMDOverdrive::isFunctionAvailable(ADLFunction::Id function) const {
+    return (availableFunctions() & (Q_UINT64_C(1) << function)) != 0;
+}
+
+quint64 AMDOverdrive::availableFunctions() const {
+    return _contextMode == PrivateContext ? (_adl.available | _adl.adl2Available) : _adl.available;
+}
+
+bool AMDOverdrive::usesPrivateContext(ADLFunction::Id function) const {
+    return _contextMode == PrivateContext && _adl.hasADL2(function);
+}
+
+void AMDOverdrive::setLoggingEnabled(bool enabled) {
+    _loggingEnabled = enabled;
+}
+
+bool AMDOverdrive::isLoggingEnabled() const {
+    return _loggingEnabled;
+}
+
+void AMDOverdrive::setLogInterval(int milliseconds) {
+    _logIntervalMilliseconds = qMax(milliseconds, 0);
+}
+
+QList<AMDOverdrive::ErrorCounter> AMDOverdrive::errorCounters() const {
+    QList<ErrorCounter> counters;
+    for(int i = 0; i < ADLFunction::NumberOfFunctions; i++) {
+        if(_errors[i].failures > 0) {
+            ErrorCounter counter;
+            counter.function = (ADLFunction::Id)i;
+            counter.name = ADLFunctionTable::name(counter.function);
+            counter.failures = _errors[i].failures;
+            counter.lastReturnCode = _errors[i].lastReturnCode;
+            counters.append(counter);
         }
-    } else {
-        functionNotAvailable("ADL_Adapter_NumberOfAdapters_Get");
     }
+    return counters;
+}
 
-    return -1;
+void AMDOverdrive::resetErrorCounters() {
+    memset(_errors, 0, sizeof(_errors));
 }
 
-QList<AdapterInfo> AMDOverdrive::adaptersInfo() {
-    QList<AdapterInfo> infoList;
+AMDOverdrive::WriteCounters AMDOverdrive::writeCounters() const {
+    return _writeCounters;
+}
 
-    if(_dll) {
-        ADL(_dll, ADL_ADAPTER_ADAPTERINFO_GET, ADL_Adapter_AdapterInfo_Get)
-        if(ADL_Adapter_AdapterInfo_Get) {
-            int n = numberOfAdapters();
-            if(n > 0) {
-                int lpAdapterInfoSize = sizeof(AdapterInfo) * n;
-
-                LPAdapterInfo lpAdapterInfo = (LPAdapterInfo)malloc(lpAdapterInfoSize);
-                memset(lpAdapterInfo,'\0', lpAdapterInfoSize);
-
-                int returnCode = ADL_Adapter_AdapterInfo_Get(lpAdapterInfo, lpAdapterInfoSize);
-                if(returnCode == ADL_OK) {
-                    for(int i = 0; i < n; i++) {
-                        infoList.append(lpAdapterInfo[i]);
-                    }
-                } else {
-                    functionCallFailed("ADL_Adapter_AdapterInfo_Get", returnCode);
-                }
-
-                free(lpAdapterInfo);
-            }
-        } else {
-            functionNotAvailable("ADL_Adapter_AdapterInfo_Get");
+void AMDOverdrive::resetWriteCounters() {
+    memset(&_writeCounters, 0, sizeof(WriteCounters));
+}
+
+void AMDOverdrive::forgetWrittenValues() {
+    _writtenValues.fill(WrittenValues());
+}
+
+void AMDOverdrive::setCircuitBreakerThreshold(int consecutiveFailures) {
+    _circuitBreakerThreshold = qMax(consecutiveFailures, 0);
+    resetCircuitBreakers();
+}
+
+void AMDOverdrive::setCircuitBreakerBackoff(int initialMilliseconds, int maximumMilliseconds) {
+    _initialBackoffMilliseconds = qMax(initialMilliseconds, 1);
+    _maximumBackoffMilliseconds = qMax(maximumMilliseconds, _initialBackoffMilliseconds);
+}
+
+bool AMDOverdrive::isCircuitOpen(int adapterIndex, ADLFunction::Id function) const {
+    int index = adapterIndex * ADLFunction::NumberOfFunctions + function;
+    if(adapterIndex < 0 || index >= _circuitBreakers.size()) {
+        return false;
+    }
+    return _circuitBreakers.at(index).backoff > 0;
+}
+
+QList<AMDOverdrive::CircuitBreakerState> AMDOverdrive::circuitBreakers() const {
+    QList<CircuitBreakerState> states;
+    qint64 now = _clock.elapsed();
+    // Only report breakers that have seen failures.
+    for(int i = 0; i < _circuitBreakers.size(); i++) {
+        const CircuitBreaker& breaker = _circuitBreakers.at(i);
+        if(breaker.consecutiveFailures == 0 && breaker.shortCircuitedCalls == 0) {
+            continue;
         }
+
+        CircuitBreakerState state;
+        state.adapterIndex = i / ADLFunction::NumberOfFunctions;
+        state.function = (ADLFunction::Id)(i % ADLFunction::NumberOfFunctions);
+        state.name = ADLFunctionTable::name(state.function);
+        state.open = breaker.backoff > 0;
+        state.consecutiveFailures = breaker.consecutiveFailures;
+        state.lastReturnCode = breaker.lastReturnCode;
+        state.retryInMilliseconds = state.open ? qMax(breaker.retryAt - now, Q_INT64_C(0)) : 0;
+        state.shortCircuitedCalls = breaker.shortCircuitedCalls;
+        states.append(state);
     }
+    return states;
+}
 
-    return infoList;
+void AMDOverdrive::resetCircuitBreakers() {
+    _circuitBreakers.fill(CircuitBreaker());
+    _circuitBreakers.resize(_capabilities.size() * ADLFunction::NumberOfFunctions);
 }
 
+ADLResult<int> AMDOverdrive::numberOfAdapters() {
+    int n = 0;
+    int returnCode = call(ADLFunction::ADL_Adapter_NumberOfAdapters_Get, _adl.ADL_Adapter_NumberOfAdapters_Get, &n);
+    if(returnCode != ADL_OK) {
+        return ADLResult<int>::failure(returnCode);
+    }
 
-int AMDOverdrive::adapterID(int adapterIndex) {
-    if(!_dll) { return -1; }
+    if(n != _capabilities.size()) {
+        // The set of adapters changed, e.g. after a driver reset.
+        invalidateCapabilities(n);
+        resetCircuitBreakers();
+        refreshMetadata();
+    }
+    return n;
+}
 
-    ADL(_dll, ADL_ADAPTER_ID_GET, ADL_Adapter_ID_Get)
+ADLResult<QList<AdapterInfo> > AMDOverdrive::adaptersInfo() {
+    QList<AdapterInfo> infoList;
+
+    if(!isFunctionAvailable(ADLFunction::ADL_Adapter_AdapterInfo_Get)) {
+        return ADLResult<QList<AdapterInfo> >::failure(reportFailure(ADLFunction::ADL_Adapter_AdapterInfo_Get, QTAMD_ERR_FUNCTION_NOT_AVAILABLE));
+    }
+
+    ADLResult<int> n = numberOfAdapters();
+    if(!n.ok()) {
+        return ADLResult<QList<AdapterInfo> >::failure(n.returnCode());
+    }
 
-    if(ADL_Adapter_ID_Get) {
-        int id, returnCode;
-        returnCode = ADL_Adapter_ID_Get(adapterIndex, &id);
+    int returnCode = ADL_OK;
+    if(n.value() > 0) {
+        int lpAdapterInfoSize = sizeof(AdapterInfo) * n.value();
+
+        LPAdapterInfo lpAdapterInfo = (LPAdapterInfo)malloc(lpAdapterInfoSize);
+        memset(lpAdapterInfo,'\0', lpAdapterInfoSize);
+
+        returnCode = call(ADLFunction::ADL_Adapter_AdapterInfo_Get, _adl.ADL_Adapter_AdapterInfo_Get, lpAdapterInfo, lpAdapterInfoSize);
         if(returnCode == ADL_OK) {
-            return id;
-        } else {
-            functionCallFailed("ADL_Adapter_ID_Get", returnCode);
+            for(int i = 0; i < n.value(); i++) {
+                infoList.append(lpAdapterInfo[i]);
+            }
         }
-    } else {
-        functionNotAvailable("ADL_Adapter_ID_Get");
+
+        free(lpAdapterInfo);
     }
 
-    return -1;
+    return ADLResult<QList<AdapterInfo> >(infoList, returnCode);
 }
 
-bool AMDOverdrive::isAdapterActive(AdapterInfo adapterInfo) {
-    bool isActive = false;
 
-    if(_dll) {
-        ADL(_dll, ADL_ADAPTER_ACTIVE_GET, ADL_Adapter_Active_Get)
-        if(ADL_Adapter_Active_Get) {
-            int adapterActive = 0;
-            int returnCode = ADL_Adapter_Active_Get(adapterInfo.iAdapterIndex, &adapterActive);
-            if(returnCode == ADL_OK) {
-                isActive = adapterActive && adapterInfo.iVendorID == AMDVENDORID;
-            } else {
-                functionCallFailed("ADL_Adapter_Active_Get", returnCode);
-            }
-        } else {
-            functionNotAvailable("ADL_Adapter_Active_Get");
-        }
+ADLResult<int> AMDOverdrive::adapterID(int adapterIndex) {
+    AdapterMetadata *metadata = 0;
+    int returnCode = cachedMetadata(adapterIndex, AdapterIDField, &metadata);
+    if(returnCode != ADL_OK) {
+        return ADLResult<int>::failure(returnCode);
     }
+    return metadata->adapterID;
+}
 
-    return isActive;
+ADLResult<bool> AMDOverdrive::isAdapterActive(AdapterInfo adapterInfo) {
+    int adapterActive = 0;
+    int returnCode = callAdapter(ADLFunction::ADL_Adapter_Active_Get, _adl.ADL_Adapter_Active_Get, adapterInfo.iAdapterIndex, &adapterActive);
+    if(returnCode != ADL_OK) {
+        return ADLResult<bool>::failure(returnCode);
+    }
+    return adapterActive && adapterInfo.iVendorID == AMDVENDORID;
 }
 
-AMDOverdrive::Capabilities AMDOverdrive::capabilities(int adapterIndex) {
-    Capabilities caps;
+ADLResult<AMDOverdrive::Capabilities> AMDOverdrive::capabilities(int adapterIndex) {
+    const AdapterCapabilities& caps = cachedCapabilities(adapterIndex);
+    return ADLResult<Capabilities>(caps.overdrive, caps.returnCode);
+}
 
-    if(_dll) {
-        ADL(_dll, ADL_OVERDRIVE_CAPS, ADL_Overdrive_Caps)
-        if(ADL_Overdrive_Caps) {
-            int returnCode = ADL_Overdrive_Caps(adapterIndex, &caps.supported, &caps.enabled, &caps.version);
-            if(returnCode != ADL_OK) {
-                functionCallFailed("ADL_Overdrive_Caps", returnCode);
-            }
-        } else {
-            functionNotAvailable("ADL_Overdrive_Caps");
-        }
+void AMDOverdrive::refreshCapabilities() {
+    invalidateCapabilities(numberOfAdapters().valueOr(0));
+    resetCircuitBreakers();
+    for(int i = 0; i < _capabilities.size(); i++) {
+        _capabilities[i] = queryCapabilities(i);
     }
+}
 
-    return caps;
+ADLResult<ADLBiosInfo> AMDOverdrive::biosInfo(int adapterIndex) {
+    AdapterMetadata *metadata = 0;
+    int returnCode = cachedMetadata(adapterIndex, BiosInfoField, &metadata);
+    if(returnCode != ADL_OK) {
+        return ADLResult<ADLBiosInfo>::failure(returnCode);
+    }
+    return metadata->biosInfo;
 }
 
-ADLBiosInfo AMDOverdrive::biosInfo(int adapterIndex) {
-    ADLBiosInfo info;
+ADLResult<AMDOverdrive::AdapterMetadata> AMDOverdrive::metadata(int adapterIndex) {
+    AdapterMetadata *metadata = 0;
+    int returnCode = cachedMetadata(adapterIndex, AllMetadataFields, &metadata);
+    return ADLResult<AdapterMetadata>(*metadata, returnCode);
+}
 
-    if(_dll) {
-        ADL(_dll, ADL_ADAPTER_VIDEOBIOSINFO_GET, ADL_Adapter_VideoBiosInfo_Get)
-        if(ADL_Adapter_VideoBiosInfo_Get) {
-            int returnCode = ADL_Adapter_VideoBiosInfo_Get(adapterIndex, &info);
-            if(returnCode != ADL_OK) {
-                functionCallFailed("ADL_Adapter_VideoBiosInfo_Get", returnCode);
-            }
-        } else {
-            functionNotAvailable("ADL_Adapter_VideoBiosInfo_Get");
-        }
+QList<AMDOverdrive::AdapterMetadata> AMDOverdrive::metadata() {
+    QList<AdapterMetadata> metadataList;
+    for(int i = 0; i < _activeGpus.size(); i++) {
+        metadataList.append(metadata(_activeGpus.at(i)).value());
     }
+    return metadataList;
+}
 
-    return info;
+void AMDOverdrive::refreshMetadata() {
+    _metadata.fill(AdapterMetadata());
+    _metadata.resize(_capabilities.size());
 }
 
-bool AMDOverdrive::isPowerControlSupported(int adapterIndex) {
-    int isSupported = 0;
-
-    if(_dll) {
-        Capabilities caps = capabilities(adapterIndex);
-        int returnCode = 0;
-        ADL(_dll, ADL_OVERDRIVE5_POWERCONTROL_CAPS, ADL_Overdrive5_PowerControl_Caps)
-        ADL(_dll, ADL_OVERDRIVE6_POWERCONTROL_CAPS, ADL_Overdrive6_PowerControl_Caps)
-
-        switch (caps.version) {
-        case 5:
-            if(ADL_Overdrive5_PowerControl_Caps) {
-                returnCode = ADL_Overdrive5_PowerControl_Caps(adapterIndex, &isSupported);
-                if(returnCode != ADL_OK) {
-                    functionCallFailed("ADL_Overdrive5_PowerControl_Caps", returnCode);
-                }
-            } else {
-                functionNotAvailable("ADL_Overdrive5_PowerControl_Caps");
-            }
-            break;
-        case 6:
-            if(ADL_Overdrive6_PowerControl_Caps) {
-                returnCode = ADL_Overdrive6_PowerControl_Caps(adapterIndex, &isSupported);
-                if(returnCode != ADL_OK) {
-                    functionCallFailed("ADL_Overdrive6_PowerControl_Caps", returnCode);
-                }
-            } else {
-                functionNotAvailable("ADL_Overdrive6_PowerControl_Caps");
-            }
-            break;
-        default:
-            qDebug() << "Overdrive version" << caps.version << "is not supported.";
-            break;
-        }
+bool AMDOverdrive::saveMetadata(const QString& fileName, const QList<AdapterMetadata>& metadata) {
+    QSaveFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly)) {
+        return false;
     }
 
-    return (bool)isSupported;
-}
-
-ADLPowerControlInfo AMDOverdrive::powerControlInfo(int adapterIndex) {
-    ADLPowerControlInfo info = {0, 0, 0};
-    ADLOD6PowerControlInfo info6 = {0, 0, 0, 0, 0};
-
-    if(_dll) {
-        if(isPowerControlSupported(adapterIndex)) {
-            Capabilities caps = capabilities(adapterIndex);
-            int returnCode = 0;
-            ADL(_dll, ADL_OVERDRIVE5_POWERCONTROLINFO_GET, ADL_Overdrive5_PowerControlInfo_Get)
-            ADL(_dll, ADL_OVERDRIVE6_POWERCONTROLINFO_GET, ADL_Overdrive6_PowerControlInfo_Get)
-
-            switch (caps.version) {
-            case 5:
-                if(ADL_Overdrive5_PowerControlInfo_Get) {
-                    returnCode = ADL_Overdrive5_PowerControlInfo_Get(adapterIndex, &info);
-                    if(returnCode != ADL_OK) {
-                        functionCallFailed("ADL_Overdrive5_PowerControlInfo_Get", returnCode);
-                    }
-                } else {
-                    functionNotAvailable("ADL_Overdrive5_PowerControlInfo_Get");
-                }
-                break;
-            case 6:
-                if(ADL_Overdrive6_PowerControlInfo_Get) {
-                    returnCode = ADL_Overdrive6_PowerControlInfo_Get(adapterIndex, &info6);
-                    info.iMinValue = info6.iMinValue;
-                    info.iMaxValue = info6.iMaxValue;
-                    info.iStepValue = info6.iStepValue;
-                    if(returnCode != ADL_OK) {
-                        functionCallFailed("ADL_Overdrive6_PowerControlInfo_Get", returnCode);
-                    }
-                } else {
-                    functionNotAvailable("ADL_Overdrive6_PowerControlInfo_Get");
-                }
-                break;
-            default:
-                qDebug() << "Overdrive version" << caps.version << "is not supported.";
-                break;
-            }
-        } else {
-            qDebug() << "Cannot retrieve power control info: power control not supported on adapter " << adapterIndex;
-        }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << metadataMagic << metadataVersion << metadata.size();
+    for(int i = 0; i < metadata.size(); i++) {
+        const AdapterMetadata& entry = metadata.at(i);
+        stream << entry.udid << entry.name
+               << entry.busNumber << entry.deviceNumber << entry.functionNumber
+               << entry.validFields << entry.adapterID;
+        // Only the used part of the BIOS strings is stored.
+        stream << QByteArray(entry.biosInfo.strPartNumber, qstrnlen(entry.biosInfo.strPartNumber, ADL_MAX_PATH))
+               << QByteArray(entry.biosInfo.strVersion, qstrnlen(entry.biosInfo.strVersion, ADL_MAX_PATH))
+               << QByteArray(entry.biosInfo.strDate, qstrnlen(entry.biosInfo.strDate, ADL_MAX_PATH));
+        stream << entry.fanSpeedInfo.iFlags
+               << entry.fanSpeedInfo.iMinPercent << entry.fanSpeedInfo.iMaxPercent
+               << entry.fanSpeedInfo.iMinRPM << entry.fanSpeedInfo.iMaxRPM;
     }
 
-    return info;
-}
-
-int AMDOverdrive::powerControlGetCurrent(int adapterIndex) {
-    int powerControlCurrent, powerControlDefault;
-
-    if(_dll) {
-        if(isPowerControlSupported(adapterIndex)) {
-            Capabilities caps = capabilities(adapterIndex);
-            int returnCode = 0;
-            ADL(_dll, ADL_OVERDRIVE5_POWERCONTROL_GET, ADL_Overdrive5_PowerControl_Get)
-            ADL(_dll, ADL_OVERDRIVE6_POWERCONTROL_GET, ADL_Overdrive6_PowerControl_Get)
-
-            switch (caps.version) {
-            case 5:
-                if(ADL_Overdrive5_PowerControl_Get) {
-                    returnCode = ADL_Overdrive5_PowerControl_Get(adapterIndex, &powerControlCurrent, &powerControlDefault);
-                    if(returnCode != ADL_OK) {
-                        functionCallFailed("ADL_Overdrive5_PowerControl_Get", returnCode);
-                    }
-                } else {
-                    functionNotAvailable("ADL_Overdrive5_PowerControl_Get");
-                }
-                break;
-            case 6:
-                if(ADL_Overdrive6_PowerControl_Get) {
-                    returnCode = ADL_Overdrive6_PowerControl_Get(adapterIndex, &powerControlCurrent, &powerControlDefault);
-                    if(returnCode != ADL_OK) {
-                        functionCallFailed("ADL_Overdrive6_PowerControl_Get", returnCode);
-                    }
-                } else {
-                    functionNotAvailable("ADL_Overdrive6_PowerControl_Get");
-                }
-                break;
-            default:
-                qDebug() << "Overdrive version" << caps.version << "is not supported.";
-                break;
-            }
-        } else {
-            qDebug() << "Cannot retrieve power control info: power control not supported on adapter " << adapterIndex;
-        }
+    if(stream.status() != QDataStream::Ok) {
+        file.cancelWriting();
+        return false;
     }
+    return file.commit();
+}
 
-    return powerControlCurrent;
-}
-
-int AMDOverdrive::powerControlGetDefault(int adapterIndex) {
-    int powerControlCurrent, powerControlDefault;
-
-    if(_dll) {
-        if(isPowerControlSupported(adapterIndex)) {
-            Capabilities caps = capabilities(adapterIndex);
-            int returnCode = 0;
-            ADL(_dll, ADL_OVERDRIVE5_POWERCONTROL_GET, ADL_Overdrive5_PowerControl_Get)
-            ADL(_dll, ADL_OVERDRIVE6_POWERCONTROL_GET, ADL_Overdrive6_PowerControl_Get)
-
-            switch (caps.version) {
-            case 5:
-                if(ADL_Overdrive5_PowerControl_Get) {
-                    returnCode = ADL_Overdrive5_PowerControl_Get(adapterIndex, &powerControlCurrent, &powerControlDefault);
-                    if(returnCode != ADL_OK) {
-                        functionCallFailed("ADL_Overdrive5_PowerControl_Get", returnCode);
-                    }
-                } else {
-                    functionNotAvailable("ADL_Overdrive5_PowerControl_Get");
-                }
-                break;
-            case 6:
-                if(ADL_Overdrive6_PowerControl_Get) {
-                    returnCode = ADL_Overdrive6_PowerControl_Get(adapterIndex, &powerControlCurrent, &powerControlDefault);
-                    if(returnCode != ADL_OK) {
-                        functionCallFailed("ADL_Overdrive6_PowerControl_Get", returnCode);
-                    }
-                } else {
-                    functionNotAvailable("ADL_Overdrive6_PowerControl_Get");
-                }
-                break;
-            default:
-                qDebug() << "Overdrive version" << caps.version << "is not supported.";
-                break;
-            }
-        } else {
-            qDebug() << "Cannot retrieve power control info: power control not supported on adapter " << adapterIndex;
-        }
+bool AMDOverdrive::loadMetadata(const QString& fileName, QList<AdapterMetadata>& metadata) {
+    metadata.clear();
+
+    QFile file(fileName);
+    if(!file.open(QIODevice::ReadOnly)) {
+        return false;
     }
 
-    return powerControlDefault;
-}
-
-bool AMDOverdrive::powerControlSet(int adapterIndex, int value) {
-    if(_dll) {
-        if(isPowerControlSupported(adapterIndex)) {
-            Capabilities caps = capabilities(adapterIndex);
-            int returnCode = 0;
-            ADL(_dll, ADL_OVERDRIVE5_POWERCONTROL_SET, ADL_Overdrive5_PowerControl_Set)
-            ADL(_dll, ADL_OVERDRIVE6_POWERCONTROL_SET, ADL_Overdrive6_PowerControl_Set)
-
-            switch (caps.version) {
-            case 5:
-                if(ADL_Overdrive5_PowerControl_Set) {
-                    returnCode = ADL_Overdrive5_PowerControl_Set(adapterIndex, value);
-                    if(returnCode == ADL_OK) {
-                        return true;
-                    } else {
-                        functionCallFailed("ADL_Overdrive5_PowerControl_Set", returnCode);
-                    }
-                } else {
-                    functionNotAvailable("ADL_Overdrive5_PowerControl_Set");
-                }
-                break;
-            case 6:
-                if(ADL_Overdrive6_PowerControl_Set) {
-                    returnCode = ADL_Overdrive6_PowerControl_Set(adapterIndex, value);
-                    if(returnCode == ADL_OK) {
-                        return true;
-                    } else {
-                        functionCallFailed("ADL_Overdrive6_PowerControl_Set", returnCode);
-                    }
-                } else {
-                    functionNotAvailable("ADL_Overdrive6_PowerControl_Set");
-                }
-                break;
-            default:
-                qDebug() << "Overdrive version" << caps.version << "is not supported.";
-                break;
-            }
-        } else {
-            qDebug() << "Cannot set power control value: power control not supported on adapter " << adapterIndex;
-        }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+    quint32 magic = 0;
+    quint16 version = 0;
+    int size = 0;
+    stream >> magic >> version >> size;
+    if(magic != metadataMagic || version != metadataVersion) {
+        return false;
     }
-    return false;
+
+    for(int i = 0; i < size && stream.status() == QDataStream::Ok; i++) {
+        AdapterMetadata entry = AdapterMetadata();
+        stream >> entry.udid >> entry.name
+               >> entry.busNumber >> entry.deviceNumber >> entry.functionNumber
+               >> entry.validFields >> entry.adapterID;
+
+        QByteArray partNumber, version, date;
+        stream >> partNumber >> version >> date;
+        qstrncpy(entry.biosInfo.strPartNumber, partNumber.constData(), ADL_MAX_PATH);
+        qstrncpy(entry.biosInfo.strVersion, version.constData(), ADL_MAX_PATH);
+        qstrncpy(entry.biosInfo.strDate, date.constData(), ADL_MAX_PATH);
+
+        entry.fanSpeedInfo.iSize = sizeof(ADLFanSpeedInfo);
+        stream >> entry.fanSpeedInfo.iFlags
+               >> entry.fanSpeedInfo.iMinPercent >> entry.fanSpeedInfo.iMaxPercent
+               >> entry.fanSpeedInfo.iMinRPM >> entry.fanSpeedInfo.iMaxRPM;
+        metadata.append(entry);
+    }
+
+    if(stream.status() != QDataStream::Ok) {
+        metadata.clear();
+        return false;
+    }
+    return true;
 }
 
-ADLODParameters AMDOverdrive::overdriveParameters(int adapterIndex) {
-    ADLODParameters overdriveParameters = {0, 0, 0, 0, 0, {0, 0, 0}, {0, 0, 0}, {0, 0, 0}};
-    overdriveParameters.iSize = sizeof(ADLODParameters);
+bool AMDOverdrive::isPowerControlSupported(int adapterIndex) {
+    return cachedCapabilities(adapterIndex).powerControlSupported;
+}
 
-    if(_dll) {
-        ADL(_dll, ADL_OVERDRIVE5_ODPARAMETERS_GET, ADL_Overdrive5_ODParameters_Get)
-        if(ADL_Overdrive5_ODParameters_Get) {
-            int returnCode = ADL_Overdrive5_ODParameters_Get(adapterIndex, &overdriveParameters);
-            if(returnCode != ADL_OK) {
-                functionCallFailed("ADL_Overdrive5_ODParameters_Get", returnCode);
-            }
-        } else {
-            functionNotAvailable("ADL_Overdrive5_ODParameters_Get");
-        }
+ADLResult<ADLPowerControlInfo> AMDOverdrive::powerControlInfo(int adapterIndex) {
+    const AdapterCapabilities& caps = cachedCapabilities(adapterIndex);
+    if(!caps.powerControlSupported) {
+        return ADLResult<ADLPowerControlInfo>::failure(ADL_ERR_NOT_SUPPORTED);
     }
+    return caps.powerControlInfo;
+}
 
-    return overdriveParameters;
+ADLResult<int> AMDOverdrive::powerControlGetCurrent(int adapterIndex) {
+    int powerControlCurrent = 0, powerControlDefault = 0;
+    int returnCode = readPowerControl(adapterIndex, &powerControlCurrent, &powerControlDefault);
+    return ADLResult<int>(returnCode == ADL_OK ? powerControlCurrent : 0, returnCode);
 }
 
-ADLPMActivity AMDOverdrive::currentActivity(int adapterIndex) {
-    ADLPMActivity activity = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
-    activity.iSize = sizeof(ADLPMActivity);
+ADLResult<int> AMDOverdrive::powerControlGetDefault(int adapterIndex) {
+    int powerControlCurrent = 0, powerControlDefault = 0;
+    int returnCode = readPowerControl(adapterIndex, &powerControlCurrent, &powerControlDefault);
+    return ADLResult<int>(returnCode == ADL_OK ? powerControlDefault : 0, returnCode);
+}
 
-    if(_dll) {
-        ADL(_dll, ADL_OVERDRIVE5_CURRENTACTIVITY_GET, ADL_Overdrive5_CurrentActivity_Get)
-        if(ADL_Overdrive5_CurrentActivity_Get) {
-            int returnCode = ADL_Overdrive5_CurrentActivity_Get(adapterIndex, &activity);
-            if(returnCode != ADL_OK) {
-                functionCallFailed("ADL_Overdrive5_CurrentActivity_Get", returnCode);
-            }
-        } else {
-            functionNotAvailable("ADL_Overdrive5_CurrentActivity_Get");
-        }
+bool AMDOverdrive::powerControlSet(int adapterIndex, int value, bool force) {
+    const AdapterCapabilities& caps = cachedCapabilities(adapterIndex);
+    if(!caps.powerControlSupported) {
+        log("Cannot set power control value: power control not supported.");
+        return false;
     }
 
-    return activity;
+    // Outputs of the same GPU share the written values.
+    int gpu = gpuAdapterIndex(adapterIndex);
+    WrittenValue *written = (gpu >= 0 && gpu < _writtenValues.size()) ? &_writtenValues[gpu].powerControl : 0;
+    if(isRedundantWrite(written, value, force, _writeCounters.suppressedPowerControlWrites)) {
+        return true;
+    }
+
+    _writeCounters.powerControlWrites++;
+    int returnCode = caps.backend->writePowerControl(adapterIndex, value);
+    rememberWrite(written, value, returnCode);
+    checkForDriverReset(returnCode);
+    return returnCode == ADL_OK;
 }
 
-QList<AMDOverdrive::PerformanceLevelInfo> AMDOverdrive::performanceLevels(int adapterIndex) {
-    QList<PerformanceLevelInfo> levels;
+ADLResult<ADLODParameters> AMDOverdrive::overdriveParameters(int adapterIndex) {
+    ADLODParameters overdriveParameters = {0, 0, 0, 0, 0, {0, 0, 0}, {0, 0, 0}, {0, 0, 0}};
+    overdriveParameters.iSize = sizeof(ADLODParameters);
 
-    if(_dll) {
-        ADLODParameters parameters = overdriveParameters(adapterIndex);
-        int n = parameters.iNumberOfPerformanceLevels;
-        if(n > 0) {
-            int size = sizeof(ADLODPerformanceLevels) + sizeof(ADLODPerformanceLevel) * (n - 1);
-            void* defaultLevelsBuffer = malloc(size);
-            memset(defaultLevelsBuffer, 0, size);
-            void* currentLevelsBuffer = malloc(size);
-            memset(currentLevelsBuffer, 0, size);
-
-            ADLODPerformanceLevels* pDefaultPerformanceLevels = (ADLODPerformanceLevels*)defaultLevelsBuffer;
-            pDefaultPerformanceLevels->iSize = size;
-            ADLODPerformanceLevels* pCurrentPerformanceLevels = (ADLODPerformanceLevels*)currentLevelsBuffer;
-            pCurrentPerformanceLevels->iSize = size;
-
-            ADL(_dll, ADL_OVERDRIVE5_ODPERFORMANCELEVELS_GET, ADL_Overdrive5_ODPerformanceLevels_Get)
-            if(ADL_Overdrive5_ODPerformanceLevels_Get) {
-                int returnCodeCurrent = ADL_Overdrive5_ODPerformanceLevels_Get(adapterIndex, 0, pCurrentPerformanceLevels);
-                int returnCodeDefault = ADL_Overdrive5_ODPerformanceLevels_Get(adapterIndex, 1, pDefaultPerformanceLevels);
-                if(returnCodeDefault == ADL_OK && returnCodeCurrent == ADL_OK) {
-                    PerformanceLevelInfo info;
-                    for (int i = 0; i < n; i++) {
-                        info.stock = pDefaultPerformanceLevels->aLevels[i];
-                        info.current = pCurrentPerformanceLevels->aLevels[i];
-                        levels.append(info);
-                    }
-                } else {
-                    functionCallFailed("ADL_Overdrive5_ODPerformanceLevels_Get", returnCodeDefault);
-                }
-            } else {
-                functionNotAvailable("ADL_Overdrive5_ODPerformanceLevels_Get");
-            }
+    int returnCode = callAdapter(ADLFunction::ADL_Overdrive5_ODParameters_Get, _adl.ADL_Overdrive5_ODParameters_Get, adapterIndex, &overdriveParameters);
+    if(returnCode != ADL_OK) {
+        return ADLResult<ADLODParameters>::failure(returnCode);
+    }
+    return overdriveParameters;
+}
+
+ADLResult<ADLPMActivity> AMDOverdrive::currentActivity(int adapterIndex) {
+    ADLPMActivity activity;
+    int returnCode = readActivity(adapterIndex, &activity);
+    return ADLResult<ADLPMActivity>(activity, returnCode);
+}
 
-            free(defaultLevelsBuffer);
-            free(currentLevelsBuffer);
+ADLResult<QList<AMDOverdrive::PerformanceLevelInfo> > AMDOverdrive::performanceLevels(int adapterIndex) {
+    QList<PerformanceLevelInfo> levels;
+
+    PerformanceLevelInfo buffer[MaxPerformanceLevels];
+    int count = 0;
+    int returnCode = readPerformanceLevels(adapterIndex, buffer, MaxPerformanceLevels, &count);
+    if(returnCode == ADL_ERR_INVALID_PARAM_SIZE && count > MaxPerformanceLevels) {
+        // More levels than fit on the stack, count is the number needed.
+        QVector<PerformanceLevelInfo> heapBuffer(count);
+        returnCode = readPerformanceLevels(adapterIndex, heapBuffer.data(), heapBuffer.size(), &count);
+        for(int i = 0; i < count; i++) {
+            levels.append(heapBuffer.at(i));
         }
+        return ADLResult<QList<PerformanceLevelInfo> >(levels, returnCode);
+    }
+    for(int i = 0; i < count; i++) {
+        levels.append(buffer[i]);
     }
+    return ADLResult<QList<PerformanceLevelInfo> >(levels, returnCode);
+}
 
-    return levels;
+ADLResult<int> AMDOverdrive::performanceLevels(int adapterIndex, PerformanceLevelInfo *levels, int capacity) {
+    int count = 0;
+    int returnCode = readPerformanceLevels(adapterIndex, levels, capacity, &count);
+    if(returnCode != ADL_OK) {
+        return ADLResult<int>::failure(returnCode);
+    }
+    return count;
+}
+
+ADLResult<AMDOverdrive::ValueRange> AMDOverdrive::performanceLevelRange(int adapterIndex, PerformanceLevelField field) {
+    // Served from the cached Overdrive parameters, without calling ADL.
+    const AdapterCapabilities& caps = cachedCapabilities(adapterIndex);
+    ValueRange range = { 0, 0, 0 };
+    int returnCode = caps.backend->performanceLevelRange(caps, field, &range);
+    return ADLResult<ValueRange>(range, returnCode);
 }
 
 bool AMDOverdrive::setCoreClock(int adapterIndex, int performanceLevel, int clockMHz) {
@@ -507,73 +533,79 @@ bool AMDOverdrive::setVoltage(int adapterIndex, int performanceLevel, int voltag
     return writePerformanceLevel(adapterIndex, performanceLevel, Voltage, voltagemV);
 }
 
-QList<ADLThermalControllerInfo> AMDOverdrive::thermalControllersInfo(int adapterIndex) {
-    QList<ADLThermalControllerInfo> info;
+int AMDOverdrive::commit(PerformanceLevelTransaction& transaction) {
+    return writePerformanceLevels(transaction._adapterIndex, transaction._edits.data(), transaction._edits.size());
+}
 
-    if(_dll) {
-        ADL(_dll, ADL_OVERDRIVE5_THERMALDEVICES_ENUM, ADL_Overdrive5_ThermalDevices_Enum)
-        if(ADL_Overdrive5_ThermalDevices_Enum) {
-            // We're probing up to ten thermal devices.
-            for(int i = 0; i < 10; i++) {
-                ADLThermalControllerInfo thermalControllerInfo = {0, 0, 0, 0};
-                thermalControllerInfo.iSize = sizeof(ADLThermalControllerInfo);
-                int returnCode = ADL_Overdrive5_ThermalDevices_Enum(adapterIndex, i, &thermalControllerInfo);
-                // If we don't get any more data, bail out.
-                if(returnCode == ADL_WARNING_NO_DATA) {
-                    break;
-                }
-                // Otherwise, collect info.
-                if(returnCode == ADL_OK) {
-                    info.append(thermalControllerInfo);
-                } else {
-                    functionCallFailed("ADL_Overdrive5_ThermalDevices_Enum", returnCode);
-                }
-            }
+AMDOverdrive::PerformanceLevelTransaction::PerformanceLevelTransaction(int adapterIndex)
+    : _adapterIndex(adapterIndex) {
+}
 
-        } else {
-            functionNotAvailable("ADL_Overdrive5_ThermalDevices_Enum");
-        }
-    }
+int AMDOverdrive::PerformanceLevelTransaction::adapterIndex() const {
+    return _adapterIndex;
+}
 
-    return info;
+void AMDOverdrive::PerformanceLevelTransaction::setAdapterIndex(int adapterIndex) {
+    _adapterIndex = adapterIndex;
 }
 
-int AMDOverdrive::temperatureMillidegreesCelsius(int adapterIndex, int thermalControllerIndex) {
-    ADLTemperature temperature = {0, 0};
-    temperature.iSize = sizeof(ADLTemperature);
+void AMDOverdrive::PerformanceLevelTransaction::setCoreClock(int performanceLevel, int clockMHz) {
+    set(performanceLevel, CoreClock, clockMHz);
+}
 
-    if(_dll) {
-        ADL(_dll, ADL_OVERDRIVE5_TEMPERATURE_GET, ADL_Overdrive5_Temperature_Get)
-        if(ADL_Overdrive5_Temperature_Get) {
-            int returnCode = ADL_Overdrive5_Temperature_Get(adapterIndex, thermalControllerIndex, &temperature);
-            if(returnCode != ADL_OK) {
-                functionCallFailed("ADL_Overdrive5_Temperature_Get", returnCode);
-            }
-        } else {
-            functionNotAvailable("ADL_Overdrive5_Temperature_Get");
-        }
-    }
+void AMDOverdrive::PerformanceLevelTransaction::setMemoryClock(int performanceLevel, int clockMHz) {
+    set(performanceLevel, MemoryClock, clockMHz);
+}
 
-    return temperature.iTemperature;
+void AMDOverdrive::PerformanceLevelTransaction::setVoltage(int performanceLevel, int voltagemV) {
+    set(performanceLevel, Voltage, voltagemV);
 }
 
-ADLFanSpeedInfo AMDOverdrive::fanSpeedInfo(int adapterIndex, int thermalControllerIndex) {
-    ADLFanSpeedInfo fanSpeedInfo = {0, 0, 0, 0, 0, 0};
-    fanSpeedInfo.iSize = sizeof(ADLFanSpeedInfo);
+void AMDOverdrive::PerformanceLevelTransaction::set(int performanceLevel, PerformanceLevelField field, int value) {
+    PerformanceLevelEdit edit = { performanceLevel, field, value, ADL_ERR, { 0, 0, 0 } };
+    _edits.append(edit);
+}
 
-    if(_dll) {
-        ADL(_dll, ADL_OVERDRIVE5_FANSPEEDINFO_GET, ADL_Overdrive5_FanSpeedInfo_Get)
-        if(ADL_Overdrive5_FanSpeedInfo_Get) {
-            int returnCode = ADL_Overdrive5_FanSpeedInfo_Get(adapterIndex, thermalControllerIndex, &fanSpeedInfo);
-            if(returnCode != ADL_OK) {
-                functionCallFailed("ADL_Overdrive5_FanSpeedInfo_Get", returnCode);
-            }
-        } else {
-            functionNotAvailable("ADL_Overdrive5_FanSpeedInfo_Get");
-        }
+const QVector<AMDOverdrive::PerformanceLevelEdit>& AMDOverdrive::PerformanceLevelTransaction::edits() const {
+    return _edits;
+}
+
+bool AMDOverdrive::PerformanceLevelTransaction::isEmpty() const {
+    return _edits.isEmpty();
+}
+
+void AMDOverdrive::PerformanceLevelTransaction::clear() {
+    // Keeps the allocated storage for the next transaction.
+    _edits.resize(0);
+}
+
+ADLResult<QList<ADLThermalControllerInfo> > AMDOverdrive::thermalControllersInfo(int adapterIndex) {
+    const AdapterCapabilities& caps = cachedCapabilities(adapterIndex);
+
+    QList<ADLThermalControllerInfo> info;
+    for(int i = 0; i < caps.numberOfThermalControllers; i++) {
+        info.append(caps.thermalControllers[i]);
+    }
+    return ADLResult<QList<ADLThermalControllerInfo> >(info, caps.thermalControllersReturnCode);
+}
+
+ADLResult<int> AMDOverdrive::temperatureMillidegreesCelsius(int adapterIndex, int thermalControllerIndex) {
+    int temperature = 0;
+    int returnCode = readTemperature(adapterIndex, thermalControllerIndex, &temperature);
+    return ADLResult<int>(temperature, returnCode);
+}
+
+ADLResult<ADLFanSpeedInfo> AMDOverdrive::fanSpeedInfo(int adapterIndex, int thermalControllerIndex) {
+    if(thermalControllerIndex < 0 || thermalControllerIndex >= MaxThermalControllers) {
+        return ADLResult<ADLFanSpeedInfo>::failure(ADL_ERR_INVALID_CONTROLLER_IDX);
     }
 
-    return fanSpeedInfo;
+    const AdapterCapabilities& caps = cachedCapabilities(adapterIndex);
+    int returnCode = caps.fanSpeedInfoReturnCodes[thermalControllerIndex];
+    if(returnCode != ADL_OK) {
+        return ADLResult<ADLFanSpeedInfo>::failure(returnCode);
+    }
+    return caps.fanSpeedInfo[thermalControllerIndex];
 }
 
 bool AMDOverdrive::fanSupportsPercentRead(ADLFanSpeedInfo fanSpeedInfo) {
@@ -592,127 +624,442 @@ bool AMDOverdrive::fanSupportsRpmWrite(ADLFanSpeedInfo fanSpeedInfo) {
     return fanSpeedInfo.iFlags & ADL_DL_FANCTRL_SUPPORTS_RPM_WRITE;
 }
 
-int AMDOverdrive::fanSpeedValue(int adapterIndex, int thermalControllerIndex, FanSpeedValueType type) {
-    ADLFanSpeedValue fanSpeedValue = {0, 0, 0, 0};
-    fanSpeedValue.iSize = sizeof(ADLFanSpeedValue);
-    fanSpeedValue.iSpeedType = (type == Rpm) ? ADL_DL_FANCTRL_SPEED_TYPE_RPM : ADL_DL_FANCTRL_SPEED_TYPE_PERCENT;
+ADLResult<int> AMDOverdrive::fanSpeedValue(int adapterIndex, int thermalControllerIndex, FanSpeedValueType type) {
+    int value = 0;
+    int returnCode = readFanSpeed(adapterIndex, thermalControllerIndex, type, &value);
+    return ADLResult<int>(value, returnCode);
+}
 
-    if(_dll) {
-        ADL(_dll, ADL_OVERDRIVE5_FANSPEED_GET, ADL_Overdrive5_FanSpeed_Get)
-        if(ADL_Overdrive5_FanSpeed_Get) {
-            int returnCode = ADL_Overdrive5_FanSpeed_Get(adapterIndex, thermalControllerIndex, &fanSpeedValue);
-            if(returnCode != ADL_OK) {
-                functionCallFailed("ADL_Overdrive5_FanSpeed_Get", returnCode);
-            }
-        } else {
-            functionNotAvailable("ADL_Overdrive5_FanSpeed_Get");
+bool AMDOverdrive::setFanSpeedValue(int adapterIndex, int thermalControllerIndex, FanSpeedValueType type, int value, bool force) {
+    WrittenValue *written = writtenFanSpeed(adapterIndex, thermalControllerIndex, type);
+    if(isRedundantWrite(written, value, force, _writeCounters.suppressedFanSpeedWrites)) {
+        return true;
+    }
+
+    _writeCounters.fanSpeedWrites++;
+    int returnCode = backend(adapterIndex)->writeFanSpeed(adapterIndex, thermalControllerIndex, type, value);
+    // The other type's value is stale once this one has been written.
+    forgetFanSpeed(adapterIndex, thermalControllerIndex);
+    rememberWrite(written, value, returnCode);
+    return returnCode == ADL_OK;
+}
+
+bool AMDOverdrive::setFanSpeedToDefault(int adapterIndex, int thermalControllerIndex) {
+    forgetFanSpeed(adapterIndex, thermalControllerIndex);
+    return backend(adapterIndex)->resetFanSpeed(adapterIndex, thermalControllerIndex) == ADL_OK;
+}
+
+void AMDOverdrive::snapshot(RigSnapshot& snapshot) {
+    snapshot.timestamp = QDateTime::currentMSecsSinceEpoch();
+    // Resizing to the same number of adapters keeps the allocated storage.
+    snapshot.adapters.resize(_activeGpus.size());
+    for(int i = 0; i < _activeGpus.size(); i++) {
+        sample(_activeGpus.at(i), snapshot.adapters[i]);
+    }
+}
+
+const QVector<int>& AMDOverdrive::activeAdapters() const {
+    return _activeAdapters;
+}
+
+const QVector<int>& AMDOverdrive::activeGpus() const {
+    return _activeGpus;
+}
+
+int AMDOverdrive::gpuAdapterIndex(int adapterIndex) const {
+    int gpuAdapterIndex = _topology->canonicalAdapterIndex(adapterIndex);
+    return gpuAdapterIndex < 0 ? adapterIndex : gpuAdapterIndex;
+}
+
+QSharedPointer<const AdapterTopology> AMDOverdrive::topology() const {
+    return _topology;
+}
+
+void AMDOverdrive::refreshAdapters() {
+    refreshCapabilities();
+
+    _activeAdapters.clear();
+    QList<AdapterInfo> infoList = adaptersInfo().value();
+    for(int i = 0; i < infoList.size(); i++) {
+        if(isAdapterActive(infoList.at(i)).value()) {
+            _activeAdapters.append(infoList.at(i).iAdapterIndex);
         }
     }
 
-    return fanSpeedValue.iFanSpeed;
+    // Readers holding the previous table keep it until they let go.
+    _topology = QSharedPointer<const AdapterTopology>(new AdapterTopology(infoList, _activeAdapters));
+
+    _activeGpus.clear();
+    for(int i = 0; i < _topology->size(); i++) {
+        const AdapterTopology::Device& device = _topology->at(i);
+        if(!device.activeAdapterIndices.isEmpty()) {
+            _activeGpus.append(device.adapterIndex);
+        }
+    }
 }
 
-bool AMDOverdrive::setFanSpeedValue(int adapterIndex, int thermalControllerIndex, FanSpeedValueType type, int value) {
-    ADLFanSpeedValue fanSpeedValue = {0, 0, 0, 0};
-    fanSpeedValue.iSize = sizeof(ADLFanSpeedValue);
-    fanSpeedValue.iSpeedType = (type == Rpm) ? ADL_DL_FANCTRL_SPEED_TYPE_RPM : ADL_DL_FANCTRL_SPEED_TYPE_PERCENT;
-    fanSpeedValue.iFanSpeed = value;
-    bool success = false;
+void AMDOverdrive::adoptTopology(const QSharedPointer<const AdapterTopology>& topology) {
+    invalidateCapabilities(topology->numberOfAdapters());
+    resetCircuitBreakers();
+    refreshMetadata();
+
+    _topology = topology;
+    _activeAdapters.clear();
+    _activeGpus.clear();
+    for(int i = 0; i < _topology->size(); i++) {
+        const AdapterTopology::Device& device = _topology->at(i);
+        for(int j = 0; j < device.activeAdapterIndices.size(); j++) {
+            _activeAdapters.append(device.activeAdapterIndices.at(j));
+        }
+        if(!device.activeAdapterIndices.isEmpty()) {
+            _activeGpus.append(device.adapterIndex);
+        }
+    }
+    std::sort(_activeAdapters.begin(), _activeAdapters.end());
+}
 
-    if(_dll) {
-        ADL(_dll, ADL_OVERDRIVE5_FANSPEED_SET, ADL_Overdrive5_FanSpeed_Set)
-        if(ADL_Overdrive5_FanSpeed_Set) {
-            int returnCode = ADL_Overdrive5_FanSpeed_Set(adapterIndex, thermalControllerIndex, &fanSpeedValue);
-            if(returnCode == ADL_OK) {
-                success = true;
-            } else {
-                functionCallFailed("ADL_Overdrive5_FanSpeed_Set", returnCode);
-            }
-        } else {
-            functionNotAvailable("ADL_Overdrive5_FanSpeed_Set");
+bool AMDOverdrive::writePerformanceLevel(int adapterIndex, int performanceLevel, AMDOverdrive::PerformanceLevelField field, int value) {
+    PerformanceLevelEdit edit = { performanceLevel, field, value, ADL_ERR, { 0, 0, 0 } };
+    if(writePerformanceLevels(adapterIndex, &edit, 1) != ADL_OK) {
+        if(edit.returnCode == ADL_ERR_INVALID_PARAM) {
+            log("Invalid performance level.");
+        } else if(edit.returnCode == QTAMD_ERR_OUT_OF_RANGE) {
+            log("Value out of range.");
         }
+        return false;
     }
+    return true;
+}
 
-    return success;
+int AMDOverdrive::writePerformanceLevels(int adapterIndex, PerformanceLevelEdit *edits, int count) {
+    if(count == 0) {
+        return ADL_OK;
+    }
+
+    const AdapterCapabilities& caps = cachedCapabilities(adapterIndex);
+    int returnCode = caps.backend->writePerformanceLevels(adapterIndex, caps, edits, count);
+    checkForDriverReset(returnCode);
+    return returnCode;
 }
 
-bool AMDOverdrive::setFanSpeedToDefault(int adapterIndex, int thermalControllerIndex) {
-    bool success = false;
-
-    if(_dll) {
-        ADL(_dll, ADL_OVERDRIVE5_FANSPEEDTODEFAULT_SET, ADL_Overdrive5_FanSpeedToDefault_Set)
-        if(ADL_Overdrive5_FanSpeedToDefault_Set) {
-            int returnCode = ADL_Overdrive5_FanSpeedToDefault_Set(adapterIndex, thermalControllerIndex);
-            if(returnCode == ADL_OK) {
-                success = true;
-            } else {
-                functionCallFailed("ADL_Overdrive5_FanSpeedToDefault_Set", returnCode);
-            }
-        } else {
-            functionNotAvailable("ADL_Overdrive5_FanSpeedToDefault_Set");
+void AMDOverdrive::sample(int adapterIndex, AdapterSample& sample) {
+    sample.adapterIndex = adapterIndex;
+    sample.timestamp = QDateTime::currentMSecsSinceEpoch();
+    sample.validFields = 0;
+    sample.fanSpeedRpm = 0;
+    sample.fanSpeedPercent = 0;
+
+    const AdapterCapabilities& caps = cachedCapabilities(adapterIndex);
+    OverdriveBackend *backend = caps.backend;
+    bool powerControlSupported = caps.powerControlSupported;
+
+    // Temperature and fan speed are read from the first thermal controller,
+    // which is the GPU itself.
+    if(readActivity(adapterIndex, &sample.activity) == ADL_OK) {
+        sample.validFields |= ActivityField;
+    }
+    if(readTemperature(adapterIndex, 0, &sample.temperatureMillidegreesCelsius) == ADL_OK) {
+        sample.validFields |= TemperatureField;
+    }
+    backend->sampleFanSpeeds(adapterIndex, caps, sample);
+    if(powerControlSupported) {
+        int powerControlDefault = 0;
+        if(readPowerControl(adapterIndex, &sample.powerControl, &powerControlDefault) == ADL_OK) {
+            sample.validFields |= PowerControlField;
         }
+    } else {
+        sample.powerControl = 0;
     }
+    if(readPerformanceLevels(adapterIndex, sample.performanceLevels, MaxPerformanceLevels, &sample.numberOfPerformanceLevels) == ADL_OK) {
+        sample.validFields |= PerformanceLevelsField;
+    } else {
+        sample.numberOfPerformanceLevels = 0;
+    }
+}
 
-    return success;
+int AMDOverdrive::readActivity(int adapterIndex, ADLPMActivity *activity) {
+    memset(activity, 0, sizeof(ADLPMActivity));
+    activity->iSize = sizeof(ADLPMActivity);
+
+    return backend(adapterIndex)->readActivity(adapterIndex, activity);
 }
 
-bool AMDOverdrive::writePerformanceLevel(int adapterIndex, int performanceLevel, AMDOverdrive::PerformanceLevelField field, int value) {
-    bool success = false;
-    if(_dll) {
-        ADLODParameters parameters = overdriveParameters(adapterIndex);
-        int n = parameters.iNumberOfPerformanceLevels;
-        if(n > 0) {
-            if(performanceLevel >= 0 && performanceLevel < n) {
-                int size = sizeof(ADLODPerformanceLevels) + sizeof(ADLODPerformanceLevel) * (n - 1);
-                void* currentLevelsBuffer = malloc(size);
-                memset(currentLevelsBuffer, 0, size);
-
-                ADLODPerformanceLevels* pCurrentPerformanceLevels = (ADLODPerformanceLevels*)currentLevelsBuffer;
-                pCurrentPerformanceLevels->iSize = size;
-
-                ADL(_dll, ADL_OVERDRIVE5_ODPERFORMANCELEVELS_GET, ADL_Overdrive5_ODPerformanceLevels_Get)
-                if(ADL_Overdrive5_ODPerformanceLevels_Get) {
-                    int returnCodeGet = ADL_Overdrive5_ODPerformanceLevels_Get(adapterIndex, 0, pCurrentPerformanceLevels);
-                    if(returnCodeGet == ADL_OK) {
-                        switch (field) {
-                        case CoreClock:
-                            pCurrentPerformanceLevels->aLevels[performanceLevel].iEngineClock = value * 100;
-                            break;
-                        case MemoryClock:
-                            pCurrentPerformanceLevels->aLevels[performanceLevel].iMemoryClock = value * 100;
-                            break;
-                        case Voltage:
-                            pCurrentPerformanceLevels->aLevels[performanceLevel].iVddc = value;
-                            break;
-                        }
-
-                        ADL(_dll, ADL_OVERDRIVE5_ODPERFORMANCELEVELS_SET, ADL_Overdrive5_ODPerformanceLevels_Set)
-                        if(ADL_Overdrive5_ODPerformanceLevels_Set) {
-                            int returnCodeSet = ADL_Overdrive5_ODPerformanceLevels_Set(adapterIndex, pCurrentPerformanceLevels);
-                            if(returnCodeSet == ADL_OK) {
-                                success = true;
-                            } else {
-                                functionCallFailed("ADL_Overdrive5_ODPerformanceLevels_Set", returnCodeSet);
-                            }
-                        } else {
-                            functionNotAvailable("ADL_Overdrive5_ODPerformanceLevels_Set");
-                        }
-                    } else {
-                        functionCallFailed("ADL_Overdrive5_ODPerformanceLevels_Get", returnCodeGet);
-                    }
-                } else {
-                    functionNotAvailable("ADL_Overdrive5_ODPerformanceLevels_Get");
-                }
-
-                free(currentLevelsBuffer);
-            } else {
-                qDebug() << "Invalid performance level, must be 0 .." << (n - 1);
-            }
+int AMDOverdrive::readTemperature(int adapterIndex, int thermalControllerIndex, int *millidegreesCelsius) {
+    *millidegreesCelsius = 0;
+    return backend(adapterIndex)->readTemperature(adapterIndex, thermalControllerIndex, millidegreesCelsius);
+}
+
+int AMDOverdrive::readFanSpeed(int adapterIndex, int thermalControllerIndex, FanSpeedValueType type, int *value) {
+    *value = 0;
+    const AdapterCapabilities& caps = cachedCapabilities(adapterIndex);
+    if(!canReadFanSpeed(caps, thermalControllerIndex, type)) {
+        return ADL_ERR_NOT_SUPPORTED;
+    }
+    return caps.backend->readFanSpeed(adapterIndex, thermalControllerIndex, type, value);
+}
+
+bool AMDOverdrive::canReadFanSpeed(const AdapterCapabilities& caps, int thermalControllerIndex, FanSpeedValueType type) {
+    if(thermalControllerIndex < 0 || thermalControllerIndex >= MaxThermalControllers
+    || caps.fanSpeedInfoReturnCodes[thermalControllerIndex] != ADL_OK) {
+        // Nothing known about this fan, so let the driver decide.
+        return true;
+    }
+    int flag = (type == Rpm) ? ADL_DL_FANCTRL_SUPPORTS_RPM_READ : ADL_DL_FANCTRL_SUPPORTS_PERCENT_READ;
+    return caps.fanSpeedInfo[thermalControllerIndex].iFlags & flag;
+}
+
+int AMDOverdrive::readPerformanceLevels(int adapterIndex, PerformanceLevelInfo *levels, int capacity, int *count) {
+    const AdapterCapabilities& caps = cachedCapabilities(adapterIndex);
+    return caps.backend->readPerformanceLevels(adapterIndex, caps, levels, capacity, count);
+}
+
+int AMDOverdrive::readPowerControl(int adapterIndex, int *current, int *defaultValue) {
+    const AdapterCapabilities& caps = cachedCapabilities(adapterIndex);
+    if(!caps.powerControlSupported) {
+        return ADL_ERR_NOT_SUPPORTED;
+    }
+
+    int returnCode = caps.backend->readPowerControl(adapterIndex, current, defaultValue);
+    checkForDriverReset(returnCode);
+    return returnCode;
+}
+
+const AMDOverdrive::AdapterCapabilities& AMDOverdrive::cachedCapabilities(int adapterIndex) {
+    if(adapterIndex < 0 || adapterIndex >= _capabilities.size()) {
+        // Not an enumerated adapter, so there's nothing to cache.
+        _uncachedCapabilities = queryCapabilities(adapterIndex);
+        return _uncachedCapabilities;
+    }
+
+    AdapterCapabilities& caps = _capabilities[adapterIndex];
+    if(!caps.valid) {
+        caps = queryCapabilities(adapterIndex);
+    }
+    return caps;
+}
+
+int AMDOverdrive::cachedMetadata(int adapterIndex, int fields, AdapterMetadata **metadata) {
+    // Metadata is the same for all outputs of a GPU.
+    int gpu = gpuAdapterIndex(adapterIndex);
+    if(gpu < 0 || gpu >= _metadata.size()) {
+        // Not an enumerated adapter, so there's nothing to cache.
+        _uncachedMetadata = AdapterMetadata();
+        *metadata = &_uncachedMetadata;
+    } else {
+        *metadata = &_metadata[gpu];
+    }
+    AdapterMetadata& entry = **metadata;
+
+    if(entry.udid.isEmpty()) {
+        int deviceIndex = _topology->deviceIndexOf(gpu);
+        if(deviceIndex >= 0) {
+            const AdapterTopology::Device& device = _topology->at(deviceIndex);
+            entry.udid = device.udid;
+            entry.name = device.name;
+            entry.busNumber = device.busNumber;
+            entry.deviceNumber = device.deviceNumber;
+            entry.functionNumber = device.functionNumber;
+        }
+    }
+
+    // Failed reads aren't cached, so they are tried again next time.
+    int returnCode = ADL_OK;
+    int missingFields = fields & ~entry.validFields;
+    if(missingFields & AdapterIDField) {
+        int result = callAdapter(ADLFunction::ADL_Adapter_ID_Get, _adl.ADL_Adapter_ID_Get, gpu, &entry.adapterID);
+        if(result == ADL_OK) {
+            entry.validFields |= AdapterIDField;
+        } else {
+            returnCode = result;
+        }
+    }
+    if(missingFields & BiosInfoField) {
+        memset(&entry.biosInfo, 0, sizeof(ADLBiosInfo));
+        int result = callAdapter(ADLFunction::ADL_Adapter_VideoBiosInfo_Get, _adl.ADL_Adapter_VideoBiosInfo_Get, gpu, &entry.biosInfo);
+        if(result == ADL_OK) {
+            entry.validFields |= BiosInfoField;
         } else {
-            qDebug() << "No performance levels available.";
+            returnCode = result;
         }
     }
+    if(missingFields & FanSpeedInfoField) {
+        ADLResult<ADLFanSpeedInfo> fanSpeedInfo = this->fanSpeedInfo(gpu, 0);
+        entry.fanSpeedInfo = fanSpeedInfo.value();
+        if(fanSpeedInfo.ok()) {
+            entry.validFields |= FanSpeedInfoField;
+        } else {
+            returnCode = fanSpeedInfo.returnCode();
+        }
+    }
+    return returnCode;
+}
+
+OverdriveBackend *AMDOverdrive::backend(int adapterIndex) {
+    return cachedCapabilities(adapterIndex).backend;
+}
+
+AMDOverdrive::AdapterCapabilities AMDOverdrive::queryCapabilities(int adapterIndex) {
+    AdapterCapabilities caps;
+    memset(&caps, 0, sizeof(AdapterCapabilities));
+
+    // Even a failed query is cached, so unsupported adapters don't cause
+    // repeated round trips. Call refreshCapabilities() to query again.
+    caps.valid = true;
+
+    caps.thermalControllersReturnCode = ADL_ERR_NOT_SUPPORTED;
+    for(int i = 0; i < MaxThermalControllers; i++) {
+        caps.fanSpeedInfoReturnCodes[i] = ADL_ERR_NOT_SUPPORTED;
+    }
+
+    caps.backend = _unsupportedBackend;
+    caps.returnCode = callAdapter(ADLFunction::ADL_Overdrive_Caps, _adl.ADL_Overdrive_Caps, adapterIndex, &caps.overdrive.supported, &caps.overdrive.enabled, &caps.overdrive.version);
+    if(caps.returnCode != ADL_OK) {
+        return caps;
+    }
+
+    // The backend is chosen once here, so calls don't have to check the
+    // Overdrive version again.
+    switch (caps.overdrive.version) {
+    case 5:
+        caps.backend = _overdrive5Backend;
+        break;
+    case 6:
+        caps.backend = _overdrive6Backend;
+        break;
+    default:
+        log("Overdrive version is not supported.");
+        break;
+    }
+
+    caps.backend->queryCapabilities(adapterIndex, caps);
+    caps.backend->queryThermalControllers(adapterIndex, caps);
+    return caps;
+}
+
+void AMDOverdrive::invalidateCapabilities(int numberOfAdapters) {
+    _capabilities.fill(AdapterCapabilities());
+    _capabilities.resize(numberOfAdapters);
 
-    return success;
+    // Written values don't survive a driver reset either.
+    _writtenValues.fill(WrittenValues());
+    _writtenValues.resize(numberOfAdapters);
 }
 
+AMDOverdrive::WrittenValue *AMDOverdrive::writtenFanSpeed(int adapterIndex, int thermalControllerIndex, FanSpeedValueType type) {
+    int gpu = gpuAdapterIndex(adapterIndex);
+    if(gpu < 0 || gpu >= _writtenValues.size()
+    || thermalControllerIndex < 0 || thermalControllerIndex >= MaxCoalescedThermalControllers) {
+        return 0;
+    }
+    return &_writtenValues[gpu].fanSpeed[thermalControllerIndex][type];
+}
+
+bool AMDOverdrive::isRedundantWrite(const WrittenValue *written, int value, bool force, quint64& suppressedWrites) {
+    if(force || !written || !written->valid || written->value != value) {
+        return false;
+    }
+    suppressedWrites++;
+    return true;
+}
+
+void AMDOverdrive::rememberWrite(WrittenValue *written, int value, int returnCode) {
+    if(!written) {
+        return;
+    }
+    // After a failed write the state of the knob is unknown.
+    written->valid = (returnCode == ADL_OK);
+    written->value = value;
+}
+
+void AMDOverdrive::forgetFanSpeed(int adapterIndex, int thermalControllerIndex) {
+    WrittenValue *rpm = writtenFanSpeed(adapterIndex, thermalControllerIndex, Rpm);
+    WrittenValue *percent = writtenFanSpeed(adapterIndex, thermalControllerIndex, Percent);
+    if(rpm) {
+        rpm->valid = false;
+        percent->valid = false;
+    }
+}
+
+void AMDOverdrive::checkForDriverReset(int returnCode) {
+    // After a driver reset, previously cached capabilities can't be trusted.
+    if(returnCode == ADL_ERR_NOT_INIT || returnCode == ADL_ERR_DISABLED_ADAPTER) {
+        invalidateCapabilities(_capabilities.size());
+    }
+}
+
+AMDOverdrive::CircuitBreaker *AMDOverdrive::circuitBreaker(int adapterIndex, ADLFunction::Id function) {
+    if(_circuitBreakerThreshold == 0) {
+        return 0;
+    }
+    int index = adapterIndex * ADLFunction::NumberOfFunctions + function;
+    if(adapterIndex < 0 || index >= _circuitBreakers.size()) {
+        // Not an enumerated adapter.
+        return 0;
+    }
+    return &_circuitBreakers[index];
+}
+
+void AMDOverdrive::updateCircuitBreaker(CircuitBreaker& breaker, int returnCode) {
+    switch(returnCode) {
+    case ADL_OK:
+    case ADL_WARNING_NO_DATA:
+        breaker.consecutiveFailures = 0;
+        breaker.backoff = 0;
+        return;
+    // These are caused by the caller's arguments rather than by the adapter.
+    case ADL_ERR_INVALID_PARAM:
+    case ADL_ERR_INVALID_PARAM_SIZE:
+    case ADL_ERR_INVALID_CONTROLLER_IDX:
+    case QTAMD_ERR_FUNCTION_NOT_AVAILABLE:
+        return;
+    }
+
+    breaker.consecutiveFailures++;
+    breaker.lastReturnCode = returnCode;
+    if(breaker.backoff > 0) {
+        // A probe failed, so wait twice as long before the next one.
+        breaker.backoff = qMin(breaker.backoff * 2, (qint64)_maximumBackoffMilliseconds);
+    } else if(breaker.consecutiveFailures >= _circuitBreakerThreshold) {
+        breaker.backoff = _initialBackoffMilliseconds;
+    } else {
+        return;
+    }
+    breaker.retryAt = _clock.elapsed() + breaker.backoff;
+}
+
+int AMDOverdrive::reportFailure(ADLFunction::Id function, int returnCode) {
+    // Failures are only counted here, messages are formatted on the slow path.
+    ErrorState& state = _errors[function];
+    state.failures++;
+    state.lastReturnCode = returnCode;
+
+    if(_loggingEnabled) {
+        logFailure(function);
+    }
+    return returnCode;
+}
+
+void AMDOverdrive::logFailure(ADLFunction::Id function) {
+    ErrorState& state = _errors[function];
+    qint64 now = _clock.elapsed();
+    if(state.loggedFailures > 0 && now - state.lastLogged < _logIntervalMilliseconds) {
+        return;
+    }
+
+    quint64 failures = state.failures - state.loggedFailures;
+    if(state.lastReturnCode == QTAMD_ERR_FUNCTION_NOT_AVAILABLE) {
+        qDebug() << "QtAMD: The function" << ADLFunctionTable::name(function)
+                 << "is not available (" << failures << "calls ).";
+    } else {
+        qDebug() << "QtAMD: Calling the function" << ADLFunctionTable::name(function)
+                 << "failed with error code" << state.lastReturnCode << "(" << failures << "failures ).";
+    }
+    state.loggedFailures = state.failures;
+    state.lastLogged = now;
+}
+
+void AMDOverdrive::log(const char *message) {
+    if(_loggingEnabled) {
+        qDebug() << "QtAMD:" << message;
+    }
+}
@@ -23,6 +23,9 @@
 #include <Qt>
 #include <QString>
 #include <QList>
+#include <QVector>
+#include <QElapsedTimer>
+#include <QSharedPointer>
 
 #if defined Q_OS_LINUX
 #   include <dlfcn.h>
@@ -40,8 +43,18 @@
 // ADL SDK includes
 #include "adl/adl_sdk.h"
 #include "adl/adl_structures.h"
+#include "adlfunctionpointers.h"
+#include "adlresult.h"
+
+class ADLContext;
+class AdapterTopology;
+class OverdriveBackend;
 
 class AMDOverdrive {
+    friend class OverdriveBackend;
+    friend class Overdrive5Backend;
+    friend class Overdrive6Backend;
+
 public:
     struct Capabilities {
         int supported;
@@ -54,59 +67,462 @@ public:
         ADLODPerformanceLevel current;
     };
 
+    enum PerformanceLevelField {
+        CoreClock,
+        MemoryClock,
+        Voltage
+    };
+
+    // Values a performance level field accepts, in MHz for clocks and mV
+    // for the voltage.
+    struct ValueRange {
+        int minimum;
+        int maximum;
+        int step;
+    };
+
+    struct PerformanceLevelEdit {
+        int performanceLevel;
+        PerformanceLevelField field;
+        // MHz for clocks, mV for the voltage. Snapped to the field's step
+        // by the commit.
+        int value;
+        // ADL_OK once the edit has been applied, otherwise the reason why
+        // it has been rejected.
+        int returnCode;
+        // Filled in by the commit, so rejected values can be corrected.
+        ValueRange allowedRange;
+    };
+
+    /**
+     * Edits of any fields of any performance levels of one adapter, which
+     * are applied together by AMDOverdrive::commit() with a single read
+     * and a single write of the adapter's performance levels.
+     */
+    class PerformanceLevelTransaction {
+    public:
+        PerformanceLevelTransaction(int adapterIndex = -1);
+
+        int adapterIndex() const;
+        void setAdapterIndex(int adapterIndex);
+
+        void setCoreClock(int performanceLevel, int clockMHz);
+        void setMemoryClock(int performanceLevel, int clockMHz);
+        void setVoltage(int performanceLevel, int voltagemV);
+        void set(int performanceLevel, PerformanceLevelField field, int value);
+
+        // Edits in the order they have been made, with their results after
+        // a commit.
+        const QVector<PerformanceLevelEdit>& edits() const;
+        bool isEmpty() const;
+        void clear();
+
+    private:
+        friend class AMDOverdrive;
+        int _adapterIndex;
+        QVector<PerformanceLevelEdit> _edits;
+    };
+
     enum FanSpeedValueType {
         Rpm,
         Percent
     };
 
-    AMDOverdrive();
+    enum {
+        MaxPerformanceLevels = 8
+    };
+
+    enum SampleField {
+        ActivityField = 0x01,
+        TemperatureField = 0x02,
+        FanSpeedRpmField = 0x04,
+        FanSpeedPercentField = 0x08,
+        PowerControlField = 0x10,
+        PerformanceLevelsField = 0x20
+    };
+
+    struct AdapterSample {
+        int adapterIndex;
+        // Milliseconds since epoch at which sampling this adapter started.
+        qint64 timestamp;
+        // SampleField flags of all fields that have been read successfully.
+        int validFields;
+        ADLPMActivity activity;
+        int temperatureMillidegreesCelsius;
+        int fanSpeedRpm;
+        int fanSpeedPercent;
+        int powerControl;
+        int numberOfPerformanceLevels;
+        // Not read on adapters with more than MaxPerformanceLevels levels,
+        // performanceLevels() returns all of them.
+        PerformanceLevelInfo performanceLevels[MaxPerformanceLevels];
+    };
+
+    struct ErrorCounter {
+        ADLFunction::Id function;
+        const char *name;
+        // Failed calls since the last resetErrorCounters().
+        quint64 failures;
+        int lastReturnCode;
+    };
+
+    struct CircuitBreakerState {
+        int adapterIndex;
+        ADLFunction::Id function;
+        const char *name;
+        // True while calls are short-circuited.
+        bool open;
+        int consecutiveFailures;
+        int lastReturnCode;
+        // Milliseconds until the function is probed again, if open.
+        qint64 retryInMilliseconds;
+        quint64 shortCircuitedCalls;
+    };
+
+    struct WriteCounters {
+        // Writes sent to the driver.
+        quint64 fanSpeedWrites;
+        quint64 powerControlWrites;
+        // Writes skipped because they wouldn't have changed anything.
+        quint64 suppressedFanSpeedWrites;
+        quint64 suppressedPowerControlWrites;
+    };
+
+    enum MetadataField {
+        AdapterIDField = 0x01,
+        BiosInfoField = 0x02,
+        FanSpeedInfoField = 0x04,
+        AllMetadataFields = 0x07
+    };
+
+    // Data that's fixed for the life of the driver, per GPU.
+    struct AdapterMetadata {
+        QString udid;
+        QString name;
+        int busNumber;
+        int deviceNumber;
+        int functionNumber;
+        // MetadataField flags of the fields below that are known.
+        int validFields;
+        int adapterID;
+        ADLBiosInfo biosInfo;
+        // Fan of the GPU's own thermal controller.
+        ADLFanSpeedInfo fanSpeedInfo;
+    };
+
+    struct RigSnapshot {
+        qint64 timestamp;
+        // One sample per active GPU. Reuse the same snapshot for every
+        // poll, so its storage is only allocated once.
+        QVector<AdapterSample> adapters;
+    };
+
+    enum ContextMode {
+        // An ADL2 context of its own if the library has ADL2, so different
+        // objects can be used from different threads at the same time.
+        // Falls back to the global context otherwise.
+        PrivateContext,
+        // The process-wide context of the legacy ADL API.
+        GlobalContext
+    };
+
+    // Loads the ADL library from libraryPath if given, from the path in the
+    // QTAMD_ADL_LIBRARY environment variable if set, or the system library.
+    // Objects using the same library share one ADL context, see
+    // adlcontext.h, which is destroyed with the last of them.
+    AMDOverdrive(QString libraryPath = QString(), ContextMode mode = PrivateContext);
+    // Takes the adapters from topology, e.g. that of another object on the
+    // same library, instead of enumerating them again. Capabilities are
+    // queried when an adapter is first used, so an object that only calls
+    // some of the GPUs only queries those. A null topology enumerates.
+    AMDOverdrive(QSharedPointer<const AdapterTopology> topology, QString libraryPath = QString(), ContextMode mode = PrivateContext);
+    ~AMDOverdrive();
+
+    // Lifecycle. reinitialize() destroys and creates the ADL context again
+    // and rereads all adapters, e.g. after a driver reset. Other objects
+    // sharing the global context only need to reread theirs when they call
+    // it. A private ADL2 context is only recreated for this object; if
+    // that fails, the error is returned and calls fail with
+    // ADL_ERR_NOT_INIT until reinitialize() succeeds.
+    int reinitialize();
+    bool isInitialized() const;
+    int contextGeneration() const;
+    // PrivateContext if calls go through an ADL2 context of this object,
+    // which is the case whenever it was asked for and the library has ADL2.
+    ContextMode contextMode() const;
+
+    // Entry points
+    bool isFunctionAvailable(ADLFunction::Id function) const;
+    quint64 availableFunctions() const;
+    // Whether calls of function go through this object's private context.
+    // Functions without an ADL2 variant use the global context, which must
+    // not be called from several threads at once.
+    bool usesPrivateContext(ADLFunction::Id function) const;
+
+    // Errors. Failed calls are always counted, but only logged if logging
+    // has been enabled, and at most once per function and log interval.
+    void setLoggingEnabled(bool enabled);
+    bool isLoggingEnabled() const;
+    void setLogInterval(int milliseconds);
+    QList<ErrorCounter> errorCounters() const;
+    void resetErrorCounters();
+
+    // Circuit breakers. After threshold consecutive failures of a function
+    // on an adapter, the function isn't called on that adapter anymore
+    // until the back-off expires. The back-off doubles with every failed
+    // probe. A threshold of 0 disables the circuit breakers.
+    void setCircuitBreakerThreshold(int consecutiveFailures);
+    void setCircuitBreakerBackoff(int initialMilliseconds, int maximumMilliseconds);
+    bool isCircuitOpen(int adapterIndex, ADLFunction::Id function) const;
+    QList<CircuitBreakerState> circuitBreakers() const;
+    void resetCircuitBreakers();
+
+    // Write coalescing. The last value successfully written to the power
+    // control and to every fan is remembered, and writing the same value
+    // again is skipped unless forced. Values changed by other programs
+    // aren't noticed, force the write or forget the written values then.
+    WriteCounters writeCounters() const;
+    void resetWriteCounters();
+    void forgetWrittenValues();
 
     // General parameters
-    int numberOfAdapters();
-    QList<AdapterInfo> adaptersInfo();
-    int adapterID(int adapterIndex);
-    bool isAdapterActive(AdapterInfo adaptersInfo);
-    Capabilities capabilities(int adapterIndex);
-    ADLBiosInfo biosInfo(int adapterIndex);
+    ADLResult<int> numberOfAdapters();
+    ADLResult<QList<AdapterInfo> > adaptersInfo();
+    ADLResult<int> adapterID(int adapterIndex);
+    ADLResult<bool> isAdapterActive(AdapterInfo adaptersInfo);
+    const QVector<int>& activeAdapters() const;
+    // ADL reports one adapter per display output. These are the adapter
+    // indices of all GPUs with active outputs, one per GPU, so every GPU
+    // is polled and controlled once. snapshot() samples these.
+    const QVector<int>& activeGpus() const;
+    // The adapter index used for calls on the GPU adapterIndex belongs to,
+    // adapterIndex itself if the adapter is unknown.
+    int gpuAdapterIndex(int adapterIndex) const;
+    // Adapters as of the last refreshAdapters(), one entry per device, see
+    // adaptertopology.h. The table is shared and never modified, instead
+    // refreshAdapters() builds a new one.
+    QSharedPointer<const AdapterTopology> topology() const;
+    void refreshAdapters();
+    ADLResult<Capabilities> capabilities(int adapterIndex);
+    void refreshCapabilities();
+    ADLResult<ADLBiosInfo> biosInfo(int adapterIndex);
+
+    // Metadata. Read once per GPU when first asked for, adapterID() and
+    // biosInfo() are served from it as well.
+    ADLResult<AdapterMetadata> metadata(int adapterIndex);
+    // Metadata of all active GPUs.
+    QList<AdapterMetadata> metadata();
+    void refreshMetadata();
+    // Compact binary form keyed by UDID. It doesn't need the ADL library,
+    // so the last known inventory can be shown while the driver starts.
+    static bool saveMetadata(const QString& fileName, const QList<AdapterMetadata>& metadata);
+    static bool loadMetadata(const QString& fileName, QList<AdapterMetadata>& metadata);
 
     // Clocks and activity
     bool isPowerControlSupported(int adapterIndex);
-    ADLPowerControlInfo powerControlInfo(int adapterIndex);
-    int powerControlGetCurrent(int adapterIndex);
-    int powerControlGetDefault(int adapterIndex);
-    bool powerControlSet(int adapterIndex, int value);
-    ADLODParameters overdriveParameters(int adapterIndex);
-    ADLPMActivity currentActivity(int adapterIndex);
-    QList<PerformanceLevelInfo> performanceLevels(int adapterIndex);
+    ADLResult<ADLPowerControlInfo> powerControlInfo(int adapterIndex);
+    ADLResult<int> powerControlGetCurrent(int adapterIndex);
+    ADLResult<int> powerControlGetDefault(int adapterIndex);
+    bool powerControlSet(int adapterIndex, int value, bool force = false);
+    ADLResult<ADLODParameters> overdriveParameters(int adapterIndex);
+    ADLResult<ADLPMActivity> currentActivity(int adapterIndex);
+    ADLResult<QList<PerformanceLevelInfo> > performanceLevels(int adapterIndex);
+    // Fills levels and returns their number. Fails with
+    // ADL_ERR_INVALID_PARAM_SIZE if the adapter has more than capacity
+    // levels. Doesn't allocate, so it's the one to poll with.
+    ADLResult<int> performanceLevels(int adapterIndex, PerformanceLevelInfo *levels, int capacity);
+    ADLResult<ValueRange> performanceLevelRange(int adapterIndex, PerformanceLevelField field);
     bool setCoreClock(int adapterIndex, int performanceLevel, int clockMHz);
     bool setMemoryClock(int adapterIndex, int performanceLevel, int clockMHz);
     bool setVoltage(int adapterIndex, int performanceLevel, int voltagemV);
+    // Returns ADL_OK if all edits have been applied. If some edits are
+    // invalid, the valid ones are still applied.
+    int commit(PerformanceLevelTransaction& transaction);
 
-    // Thermal control
-    QList<ADLThermalControllerInfo> thermalControllersInfo(int adapterIndex);
-    int temperatureMillidegreesCelsius(int adapterIndex, int thermalControllerIndex);
-    ADLFanSpeedInfo fanSpeedInfo(int adapterIndex, int thermalControllerIndex);
+    // Thermal control. Thermal controllers and their fans are enumerated
+    // once with the adapter's capabilities, refreshCapabilities()
+    // enumerates them again.
+    ADLResult<QList<ADLThermalControllerInfo> > thermalControllersInfo(int adapterIndex);
+    ADLResult<int> temperatureMillidegreesCelsius(int adapterIndex, int thermalControllerIndex);
+    ADLResult<ADLFanSpeedInfo> fanSpeedInfo(int adapterIndex, int thermalControllerIndex);
     bool fanSupportsPercentRead(ADLFanSpeedInfo fanSpeedInfo);
     bool fanSupportsRpmRead(ADLFanSpeedInfo fanSpeedInfo);
     bool fanSupportsPercentWrite(ADLFanSpeedInfo fanSpeedInfo);
     bool fanSupportsRpmWrite(ADLFanSpeedInfo fanSpeedInfo);
-    int fanSpeedValue(int adapterIndex, int thermalControllerIndex, FanSpeedValueType type);
-    bool setFanSpeedValue(int adapterIndex, int thermalControllerIndex, FanSpeedValueType type, int value);
+    ADLResult<int> fanSpeedValue(int adapterIndex, int thermalControllerIndex, FanSpeedValueType type);
+    bool setFanSpeedValue(int adapterIndex, int thermalControllerIndex, FanSpeedValueType type, int value, bool force = false);
     bool setFanSpeedToDefault(int adapterIndex, int thermalControllerIndex);
 
+    // Telemetry
+    void snapshot(RigSnapshot& snapshot);
+    // Samples a single GPU, see parallelsweeper.h to sample several at once.
+    void sample(int adapterIndex, AdapterSample& sample);
+
 private:
-    enum PerformanceLevelField {
-        CoreClock,
-        MemoryClock,
-        Voltage
+    enum {
+        // Thermal controllers probed per adapter.
+        MaxThermalControllers = 10,
+        // Fans of thermal controllers beyond this aren't coalesced.
+        MaxCoalescedThermalControllers = 4
+    };
+
+    struct AdapterCapabilities {
+        bool valid;
+        // Return code of ADL_Overdrive_Caps.
+        int returnCode;
+        Capabilities overdrive;
+        bool powerControlSupported;
+        ADLPowerControlInfo powerControlInfo;
+        ADLODParameters overdriveParameters;
+        ADLOD6Capabilities overdrive6Capabilities;
+        // Enumerated thermal controllers, and the fan of every thermal
+        // controller, indexed by thermal controller index.
+        int thermalControllersReturnCode;
+        int numberOfThermalControllers;
+        ADLThermalControllerInfo thermalControllers[MaxThermalControllers];
+        int fanSpeedInfoReturnCodes[MaxThermalControllers];
+        ADLFanSpeedInfo fanSpeedInfo[MaxThermalControllers];
+        // Implements the calls for this adapter's Overdrive version.
+        OverdriveBackend *backend;
+    };
+
+    struct CircuitBreaker {
+        int consecutiveFailures;
+        int lastReturnCode;
+        // Back-off of the current open period, 0 while closed.
+        qint64 backoff;
+        qint64 retryAt;
+        quint64 shortCircuitedCalls;
+    };
+
+    struct ErrorState {
+        quint64 failures;
+        quint64 loggedFailures;
+        int lastReturnCode;
+        qint64 lastLogged;
+    };
+
+    struct WrittenValue {
+        bool valid;
+        int value;
+    };
+
+    struct WrittenValues {
+        WrittenValue powerControl;
+        // Indexed by thermal controller and FanSpeedValueType. Only one
+        // type per fan is valid at a time.
+        WrittenValue fanSpeed[MaxCoalescedThermalControllers][2];
     };
 
     bool writePerformanceLevel(int adapterIndex, int performanceLevel, PerformanceLevelField field, int value);
+    int writePerformanceLevels(int adapterIndex, PerformanceLevelEdit *edits, int count);
+    int readActivity(int adapterIndex, ADLPMActivity *activity);
+    int readTemperature(int adapterIndex, int thermalControllerIndex, int *millidegreesCelsius);
+    int readFanSpeed(int adapterIndex, int thermalControllerIndex, FanSpeedValueType type, int *value);
+    // False if the cached fan info says the fan can't report type.
+    static bool canReadFanSpeed(const AdapterCapabilities& caps, int thermalControllerIndex, FanSpeedValueType type);
+    int readPowerControl(int adapterIndex, int *current, int *defaultValue);
+    int readPerformanceLevels(int adapterIndex, PerformanceLevelInfo *levels, int capacity, int *count);
 
-#if defined Q_OS_LINUX
-    void *_dll;
-#else
-    HINSTANCE _dll;
-#endif
+    const AdapterCapabilities& cachedCapabilities(int adapterIndex);
+    // Reads the missing fields of the GPU's metadata. Returns ADL_OK if all
+    // fields are known, the last error otherwise.
+    int cachedMetadata(int adapterIndex, int fields, AdapterMetadata **metadata);
+    OverdriveBackend *backend(int adapterIndex);
+    AdapterCapabilities queryCapabilities(int adapterIndex);
+    void invalidateCapabilities(int numberOfAdapters);
+    // Takes the adapters from a topology built by another object.
+    void adoptTopology(const QSharedPointer<const AdapterTopology>& topology);
+    WrittenValue *writtenFanSpeed(int adapterIndex, int thermalControllerIndex, FanSpeedValueType type);
+    bool isRedundantWrite(const WrittenValue *written, int value, bool force, quint64& suppressedWrites);
+    void rememberWrite(WrittenValue *written, int value, int returnCode);
+    void forgetFanSpeed(int adapterIndex, int thermalControllerIndex);
+    void checkForDriverReset(int returnCode);
+
+    // Calls an ADL function if it is available and counts its failures.
+    // ADL_WARNING_NO_DATA is returned but isn't a failure.
+    template<typename Function, typename... Arguments>
+    int call(ADLFunction::Id function, Function entryPoint, Arguments... arguments) {
+        int returnCode;
+        if(_contextMode == PrivateContext && _adl.hasADL2(function)) {
+            if(!_adl2Context) {
+                return reportFailure(function, ADL_ERR_NOT_INIT);
+            }
+            // Same arguments, but on this object's own context.
+            returnCode = ((typename ADL2Function<Function>::Type)_adl.adl2[function])(_adl2Context, arguments...);
+        } else if(_adl.has(function)) {
+            returnCode = entryPoint(arguments...);
+        } else {
+            return reportFailure(function, QTAMD_ERR_FUNCTION_NOT_AVAILABLE);
+        }
+        if(returnCode != ADL_OK && returnCode != ADL_WARNING_NO_DATA) {
+            reportFailure(function, returnCode);
+        }
+        return returnCode;
+    }
+
+    // Same as call() for functions taking an adapter index, but guarded by
+    // that adapter's circuit breaker.
+    template<typename Function, typename... Arguments>
+    int callAdapter(ADLFunction::Id function, Function entryPoint, int adapterIndex, Arguments... arguments) {
+        CircuitBreaker *breaker = circuitBreaker(adapterIndex, function);
+        if(breaker && breaker->backoff > 0 && _clock.elapsed() < breaker->retryAt) {
+            breaker->shortCircuitedCalls++;
+            return QTAMD_ERR_CIRCUIT_OPEN;
+        }
+        int returnCode = call(function, entryPoint, adapterIndex, arguments...);
+        if(breaker) {
+            updateCircuitBreaker(*breaker, returnCode);
+        }
+        return returnCode;
+    }
+
+    CircuitBreaker *circuitBreaker(int adapterIndex, ADLFunction::Id function);
+    void updateCircuitBreaker(CircuitBreaker& breaker, int returnCode);
+
+    int reportFailure(ADLFunction::Id function, int returnCode);
+    void logFailure(ADLFunction::Id function);
+    void log(const char *message);
+
+    // Shared with all AMDOverdrive objects using the same library.
+    QSharedPointer<ADLContext> _context;
+    int _contextGeneration;
+    ADLFunctionTable _adl;
+    // PrivateContext only if the library has ADL2.
+    ContextMode _contextMode;
+    // This object's own ADL2 context, 0 in GlobalContext mode or if it
+    // couldn't be created.
+    ADL_CONTEXT_HANDLE _adl2Context;
+
+    // One backend per Overdrive version, shared by all adapters.
+    OverdriveBackend *_overdrive5Backend;
+    OverdriveBackend *_overdrive6Backend;
+    OverdriveBackend *_unsupportedBackend;
+
+    // Per-adapter capabilities, indexed by adapter index.
+    QVector<AdapterCapabilities> _capabilities;
+    AdapterCapabilities _uncachedCapabilities;
+    // Per-GPU metadata, indexed by the GPU's adapter index.
+    QVector<AdapterMetadata> _metadata;
+    AdapterMetadata _uncachedMetadata;
+    // Per-GPU written values, indexed by the GPU's adapter index.
+    QVector<WrittenValues> _writtenValues;
+    WriteCounters _writeCounters;
+    QVector<int> _activeAdapters;
+    QVector<int> _activeGpus;
+    QSharedPointer<const AdapterTopology> _topology;
+
+    ErrorState _errors[ADLFunction::NumberOfFunctions];
+    bool _loggingEnabled;
+    int _logIntervalMilliseconds;
+    QElapsedTimer _clock;
+
+    // Per-adapter circuit breakers, indexed by
+    // adapterIndex * NumberOfFunctions + function.
+    QVector<CircuitBreaker> _circuitBreakers;
+    int _circuitBreakerThreshold;
+    int _initialBackoffMilliseconds;
+    int _maximumBackoffMilliseconds;
 
+    Q_DISABLE_COPY(AMDOverdrive)
 };
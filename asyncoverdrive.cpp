@@ -0,0 +1,248 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+//    This file is part of QtAMD.                                            //
+//    Copyright (C) 2015-2016 Jacob Dawid, jacob@omg-it.works                //
+//                                                                           //
+//    QtAMD is free software: you can redistribute it and/or modify          //
+//    it under the terms of the GNU Affero General Public License as         //
+//    published by the Free Software Foundation, either version 3 of the     //
+//    License, or (at your option) any later version.                        //
+//                                                                           //
+//    QtAMD is distributed in the hope that it will be useful,               //
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of         //
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          //
+//    GNU Affero General Public License for more details.                    //
+//                                                                           //
+//    You should have received a copy of the GNU General Public License      //
+//    along with QtAMD. If not, see <http://www.gnu.org/licenses/>.          //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "asyncoverdrive.h"
+#include "adaptertopology.h"
+
+#include <string.h>
+
+AsyncOverdrive::AsyncOverdrive(const QString& libraryPath)
+    : _libraryPath(libraryPath),
+      _stopRequested(false),
+      _nextSequence(0),
+      _pendingRequests(0) {
+    memset(&_counters, 0, sizeof(Counters));
+    memset(_priorityCounters, 0, sizeof(_priorityCounters));
+    _clock.start();
+
+    setPriority(&AMDOverdrive::setFanSpeedValue, SafetyPriority);
+    setPriority(&AMDOverdrive::powerControlSet, SafetyPriority);
+    setPriority(static_cast<ADLResult<QList<AMDOverdrive::PerformanceLevelInfo> > (AMDOverdrive::*)(int)>(&AMDOverdrive::performanceLevels), BulkPriority);
+    setPriority(static_cast<ADLResult<int> (AMDOverdrive::*)(int, AMDOverdrive::PerformanceLevelInfo*, int)>(&AMDOverdrive::performanceLevels), BulkPriority);
+    setPriority(&AMDOverdrive::biosInfo, BulkPriority);
+    start();
+}
+
+AsyncOverdrive::~AsyncOverdrive() {
+    _mutex.lock();
+    _stopRequested = true;
+    _wakeUp.wakeAll();
+    _mutex.unlock();
+    wait();
+
+    // Requests that never ran are canceled.
+    for(int priority = 0; priority < NumberOfPriorities; priority++) {
+        QList<QList<Request*> > queues = _queues[priority].values();
+        for(int i = 0; i < queues.size(); i++) {
+            for(int j = 0; j < queues.at(i).size(); j++) {
+                queues.at(i).at(j)->cancel();
+                delete queues.at(i).at(j);
+            }
+        }
+    }
+}
+
+AsyncOverdrive::Counters AsyncOverdrive::counters() const {
+    QMutexLocker locker(&_mutex);
+    return _counters;
+}
+
+AsyncOverdrive::PriorityCounters AsyncOverdrive::priorityCounters(Priority priority) const {
+    QMutexLocker locker(&_mutex);
+    return _priorityCounters[priority];
+}
+
+int AsyncOverdrive::pendingRequests() const {
+    QMutexLocker locker(&_mutex);
+    return _pendingRequests;
+}
+
+void AsyncOverdrive::run() {
+    AMDOverdrive overdrive(_libraryPath);
+    QSharedPointer<const AdapterTopology> topology = overdrive.topology();
+
+    _mutex.lock();
+    // Requests queued before the topology was known.
+    regroup(*topology);
+    while(!_stopRequested) {
+        Request *request = takeNext();
+        if(!request) {
+            _wakeUp.wait(&_mutex);
+            continue;
+        }
+
+        _mutex.unlock();
+        request->execute(overdrive);
+        // E.g. refreshAdapters() and reinitialize() build a new topology.
+        QSharedPointer<const AdapterTopology> current = overdrive.topology();
+        _mutex.lock();
+        retire(request);
+        if(current.data() != topology.data()) {
+            topology = current;
+            regroup(*topology);
+        }
+        _mutex.unlock();
+        request->finish();
+        delete request;
+        _mutex.lock();
+    }
+    _mutex.unlock();
+}
+
+int AsyncOverdrive::queueOf(int adapterIndex) const {
+    if(adapterIndex < 0 || adapterIndex >= _gpuQueues.size()) {
+        return adapterIndex;
+    }
+    return _gpuQueues.at(adapterIndex);
+}
+
+void AsyncOverdrive::regroup(const AdapterTopology& topology) {
+    _gpuQueues.resize(topology.numberOfAdapters());
+    for(int i = 0; i < _gpuQueues.size(); i++) {
+        int gpuAdapterIndex = topology.canonicalAdapterIndex(i);
+        _gpuQueues[i] = gpuAdapterIndex < 0 ? i : gpuAdapterIndex;
+    }
+
+    // A read queued on one output can't tell anymore which writes on the
+    // other outputs of its GPU came after it, so none are shared.
+    _reads.clear();
+    for(int priority = 0; priority < NumberOfPriorities; priority++) {
+        QList<QList<Request*> > queues = _queues[priority].values();
+        _queues[priority].clear();
+        _readyQueues[priority].clear();
+        for(int i = 0; i < queues.size(); i++) {
+            for(int j = 0; j < queues.at(i).size(); j++) {
+                Request *request = queues.at(i).at(j);
+                request->queue = queueOf(request->adapterIndex);
+                // insert() counts it again.
+                _priorityCounters[priority].pendingRequests--;
+                insert(request);
+            }
+        }
+    }
+}
+
+void AsyncOverdrive::append(Request *request) {
+    request->sequence = _nextSequence++;
+    request->queuedAt = _clock.nsecsElapsed();
+    _priorityCounters[request->priority].requests++;
+    _pendingRequests++;
+
+    if(request->write) {
+        // Earlier writes on the GPU mustn't overtake this one.
+        for(int priority = request->priority + 1; priority < NumberOfPriorities; priority++) {
+            QList<Request*> queue = _queues[priority].value(request->queue);
+            for(int i = 0; i < queue.size(); i++) {
+                if(queue.at(i)->write) {
+                    promote(queue.at(i), request->priority);
+                }
+            }
+        }
+        // Reads queued before a write mustn't answer reads queued after it.
+        // Writes not aimed at an adapter, e.g. reinitialize(), may change
+        // what reads on any adapter return.
+        if(request->queue == RigQueue) {
+            _reads.clear();
+        } else {
+            _reads.remove(request->queue);
+        }
+    } else if(!request->key.isEmpty()) {
+        _reads[request->queue].insert(request->key, request);
+    }
+    insert(request);
+    _wakeUp.wakeAll();
+}
+
+void AsyncOverdrive::promote(Request *request, Priority priority) {
+    if(request->priority <= priority) {
+        return;
+    }
+    QList<Request*>& queue = _queues[request->priority][request->queue];
+    int index = queue.indexOf(request);
+    if(index < 0) {
+        // Already running.
+        return;
+    }
+    queue.removeAt(index);
+    if(queue.isEmpty()) {
+        _queues[request->priority].remove(request->queue);
+        _readyQueues[request->priority].removeAt(_readyQueues[request->priority].indexOf(request->queue));
+    }
+    _priorityCounters[request->priority].requests--;
+    _priorityCounters[request->priority].pendingRequests--;
+
+    request->priority = priority;
+    _priorityCounters[priority].requests++;
+    insert(request);
+}
+
+void AsyncOverdrive::insert(Request *request) {
+    QList<Request*>& queue = _queues[request->priority][request->queue];
+    if(queue.isEmpty()) {
+        _readyQueues[request->priority].append(request->queue);
+    }
+    int index = queue.size();
+    while(index > 0 && queue.at(index - 1)->sequence > request->sequence) {
+        index--;
+    }
+    queue.insert(index, request);
+
+    PriorityCounters& counters = _priorityCounters[request->priority];
+    counters.pendingRequests++;
+    counters.peakPendingRequests = qMax(counters.peakPendingRequests, counters.pendingRequests);
+}
+
+AsyncOverdrive::Request *AsyncOverdrive::takeNext() {
+    for(int priority = 0; priority < NumberOfPriorities; priority++) {
+        if(_readyQueues[priority].isEmpty()) {
+            continue;
+        }
+
+        // Queues take turns, one request each.
+        int queueIndex = _readyQueues[priority].takeFirst();
+        QList<Request*>& queue = _queues[priority][queueIndex];
+        Request *request = queue.takeFirst();
+        if(queue.isEmpty()) {
+            _queues[priority].remove(queueIndex);
+        } else {
+            _readyQueues[priority].append(queueIndex);
+        }
+
+        PriorityCounters& counters = _priorityCounters[priority];
+        qint64 waitMicroseconds = (_clock.nsecsElapsed() - request->queuedAt) / 1000;
+        counters.pendingRequests--;
+        counters.totalWaitMicroseconds += waitMicroseconds;
+        counters.maxWaitMicroseconds = qMax(counters.maxWaitMicroseconds, waitMicroseconds);
+        return request;
+    }
+    return 0;
+}
+
+void AsyncOverdrive::retire(Request *request) {
+    if(!request->key.isEmpty()) {
+        QHash<QByteArray, Request*>& reads = _reads[request->queue];
+        if(reads.value(request->key, 0) == request) {
+            reads.remove(request->key);
+        }
+    }
+    _counters.executedRequests++;
+    _priorityCounters[request->priority].executedRequests++;
+    _pendingRequests--;
+}
@@ -0,0 +1,388 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+//    This file is part of QtAMD.                                            //
+//    Copyright (C) 2015-2016 Jacob Dawid, jacob@omg-it.works                //
+//                                                                           //
+//    QtAMD is free software: you can redistribute it and/or modify          //
+//    it under the terms of the GNU Affero General Public License as         //
+//    published by the Free Software Foundation, either version 3 of the     //
+//    License, or (at your option) any later version.                        //
+//                                                                           //
+//    QtAMD is distributed in the hope that it will be useful,               //
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of         //
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          //
+//    GNU Affero General Public License for more details.                    //
+//                                                                           //
+//    You should have received a copy of the GNU General Public License      //
+//    along with QtAMD. If not, see <http://www.gnu.org/licenses/>.          //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QFuture>
+#include <QFutureInterface>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QVector>
+
+#include <functional>
+#include <type_traits>
+
+#include "amdoverdrive.h"
+
+/**
+ * Runs AMDOverdrive calls on a driver thread of its own and returns their
+ * results as QFutures, so a GUI thread never waits for a stalled driver.
+ * Watch a future with a QFutureWatcher to get a signal when it's done.
+ *
+ * Any public AMDOverdrive method can be called, e.g.
+ *
+ *     async.read(&AMDOverdrive::temperatureMillidegreesCelsius, adapterIndex, 0);
+ *     async.write(&AMDOverdrive::setCoreClock, adapterIndex, 1, 900);
+ *
+ * Overloaded methods have to be picked with a cast:
+ *
+ *     typedef ADLResult<QList<AMDOverdrive::PerformanceLevelInfo> > (AMDOverdrive::*PerformanceLevels)(int);
+ *     async.read(static_cast<PerformanceLevels>(&AMDOverdrive::performanceLevels), adapterIndex);
+ *
+ * Arguments are converted to the method's parameter types and copied, and
+ * default arguments have to be passed. Results returned by reference are
+ * copied on the driver thread. Methods that fill a non-const reference,
+ * commit() and snapshot(), don't compile: the driver thread would only
+ * fill its own copy. Requests
+ * whose first argument is an int are queued for the GPU of that adapter,
+ * so calls through different outputs of one GPU share a queue, and all
+ * others in a queue of their own. Each queue runs in order, and the queues
+ * take turns, so a backlog on one GPU doesn't hold up the others. A read
+ * identical to one already queued or running, without a write queued on
+ * the same GPU since, shares that read's future instead of calling the
+ * driver again. A write not aimed at an adapter ends sharing on all GPUs.
+ *
+ * Every request has a priority, by default the one set for its method with
+ * setPriority(). The driver thread always takes the next request from the
+ * most urgent priority with requests queued, so a fan speed write doesn't
+ * wait for a sweep of performance level reads queued before it. A request
+ * that is already running isn't interrupted. Writes on a GPU still run in
+ * the order they were queued: queuing a write lifts earlier writes on the
+ * same GPU to its priority.
+ */
+class AsyncOverdrive : public QThread {
+public:
+    enum Priority {
+        // Writes that keep the hardware safe, e.g. fan speed and power.
+        SafetyPriority,
+        NormalPriority,
+        // Reads of large or rarely changing data, e.g. performance levels.
+        BulkPriority,
+        NumberOfPriorities
+    };
+
+    struct PriorityCounters {
+        // Requests queued at or promoted to this priority, not counting
+        // shared reads.
+        quint64 requests;
+        quint64 executedRequests;
+        // Requests waiting at this priority, not counting a running one.
+        int pendingRequests;
+        int peakPendingRequests;
+        // Time from queuing a request until it started running.
+        qint64 totalWaitMicroseconds;
+        qint64 maxWaitMicroseconds;
+    };
+
+    struct Counters {
+        quint64 requests;
+        // Reads that shared the future of an identical read.
+        quint64 coalescedReads;
+        quint64 executedRequests;
+    };
+
+    // The AMDOverdrive is created on the driver thread, so not even loading
+    // the library blocks the caller.
+    AsyncOverdrive(const QString& libraryPath = QString());
+    ~AsyncOverdrive();
+
+    template<typename Result, typename... Parameters, typename... Arguments>
+    QFuture<typename std::decay<Result>::type> read(Result (AMDOverdrive::*method)(Parameters...), Arguments... arguments) {
+        return enqueue<Result, Parameters...>(false, MethodPriority, method, arguments...);
+    }
+
+    template<typename Result, typename... Parameters, typename... Arguments>
+    QFuture<typename std::decay<Result>::type> read(Result (AMDOverdrive::*method)(Parameters...) const, Arguments... arguments) {
+        return enqueue<Result, Parameters...>(false, MethodPriority, method, arguments...);
+    }
+
+    template<typename Result, typename... Parameters, typename... Arguments>
+    QFuture<typename std::decay<Result>::type> read(Priority priority, Result (AMDOverdrive::*method)(Parameters...), Arguments... arguments) {
+        return enqueue<Result, Parameters...>(false, priority, method, arguments...);
+    }
+
+    template<typename Result, typename... Parameters, typename... Arguments>
+    QFuture<typename std::decay<Result>::type> read(Priority priority, Result (AMDOverdrive::*method)(Parameters...) const, Arguments... arguments) {
+        return enqueue<Result, Parameters...>(false, priority, method, arguments...);
+    }
+
+    template<typename Result, typename... Parameters, typename... Arguments>
+    QFuture<typename std::decay<Result>::type> write(Result (AMDOverdrive::*method)(Parameters...), Arguments... arguments) {
+        return enqueue<Result, Parameters...>(true, MethodPriority, method, arguments...);
+    }
+
+    template<typename Result, typename... Parameters, typename... Arguments>
+    QFuture<typename std::decay<Result>::type> write(Result (AMDOverdrive::*method)(Parameters...) const, Arguments... arguments) {
+        return enqueue<Result, Parameters...>(true, MethodPriority, method, arguments...);
+    }
+
+    template<typename Result, typename... Parameters, typename... Arguments>
+    QFuture<typename std::decay<Result>::type> write(Priority priority, Result (AMDOverdrive::*method)(Parameters...), Arguments... arguments) {
+        return enqueue<Result, Parameters...>(true, priority, method, arguments...);
+    }
+
+    template<typename Result, typename... Parameters, typename... Arguments>
+    QFuture<typename std::decay<Result>::type> write(Priority priority, Result (AMDOverdrive::*method)(Parameters...) const, Arguments... arguments) {
+        return enqueue<Result, Parameters...>(true, priority, method, arguments...);
+    }
+
+    // Priority of requests that don't name one. setFanSpeedValue() and
+    // powerControlSet() default to SafetyPriority, performanceLevels() and
+    // biosInfo() to BulkPriority and everything else to NormalPriority.
+    template<typename Result, typename... Parameters>
+    void setPriority(Result (AMDOverdrive::*method)(Parameters...), Priority priority) {
+        QMutexLocker locker(&_mutex);
+        _priorities.insert(methodKey(method), priority);
+    }
+
+    template<typename Result, typename... Parameters>
+    void setPriority(Result (AMDOverdrive::*method)(Parameters...) const, Priority priority) {
+        QMutexLocker locker(&_mutex);
+        _priorities.insert(methodKey(method), priority);
+    }
+
+    template<typename Result, typename... Parameters>
+    Priority priority(Result (AMDOverdrive::*method)(Parameters...)) const {
+        QMutexLocker locker(&_mutex);
+        return _priorities.value(methodKey(method), NormalPriority);
+    }
+
+    template<typename Result, typename... Parameters>
+    Priority priority(Result (AMDOverdrive::*method)(Parameters...) const) const {
+        QMutexLocker locker(&_mutex);
+        return _priorities.value(methodKey(method), NormalPriority);
+    }
+
+    Counters counters() const;
+    PriorityCounters priorityCounters(Priority priority) const;
+    // Requests queued or running.
+    int pendingRequests() const;
+
+protected:
+    void run();
+
+private:
+    // Queue of requests not aimed at an adapter.
+    enum { RigQueue = -1 };
+    // Takes the priority set for the method.
+    enum { MethodPriority = -1 };
+
+    class Request {
+    public:
+        Request() : adapterIndex(RigQueue), queue(RigQueue), priority(NormalPriority), write(false), sequence(0), queuedAt(0) {}
+        virtual ~Request() {}
+        // Calls the driver. The result is only published by finish(), once
+        // the request can't be shared anymore.
+        virtual void execute(AMDOverdrive& overdrive) = 0;
+        virtual void finish() = 0;
+        virtual void cancel() = 0;
+
+        // The adapter the request is aimed at, and the queue of its GPU.
+        int adapterIndex;
+        int queue;
+        Priority priority;
+        bool write;
+        // Order of queuing, which requests keep within each queue.
+        quint64 sequence;
+        qint64 queuedAt;
+        // Identifies identical reads, empty if they can't be told apart.
+        QByteArray key;
+    };
+
+    template<typename Result>
+    class Call : public Request {
+    public:
+        Call(const std::function<Result(AMDOverdrive&)>& function) : _function(function) {
+            _interface.reportStarted();
+        }
+        void execute(AMDOverdrive& overdrive) {
+            _result = _function(overdrive);
+        }
+        void finish() {
+            _interface.reportFinished(&_result);
+        }
+        void cancel() {
+            _interface.reportCanceled();
+            _interface.reportFinished();
+        }
+        QFuture<Result> future() {
+            return _interface.future();
+        }
+
+    private:
+        std::function<Result(AMDOverdrive&)> _function;
+        QFutureInterface<Result> _interface;
+        Result _result;
+    };
+
+    // The first argument is the adapter index, if it's an int.
+    static int adapterOf() {
+        return RigQueue;
+    }
+    template<typename First, typename... Rest>
+    static int adapterOf(const First& first, const Rest&...) {
+        return adapterIndexOf(first, std::is_same<First, int>());
+    }
+    template<typename First>
+    static int adapterIndexOf(const First& first, std::true_type) {
+        return first;
+    }
+    template<typename First>
+    static int adapterIndexOf(const First&, std::false_type) {
+        return RigQueue;
+    }
+
+    // Whether any parameter is a non-const lvalue reference, which the
+    // method would fill in.
+    template<typename... Types>
+    struct HasOutputParameter : std::false_type {};
+    template<typename First, typename... Rest>
+    struct HasOutputParameter<First, Rest...> : std::integral_constant<bool,
+            (std::is_lvalue_reference<First>::value && !std::is_const<typename std::remove_reference<First>::type>::value)
+            || HasOutputParameter<Rest...>::value> {};
+
+    template<typename Method>
+    static QByteArray methodKey(Method method) {
+        return QByteArray((const char*)&method, sizeof(method));
+    }
+
+    // Appends the bytes of all arguments to key. Arguments that can't be
+    // compared by their bytes make the key empty.
+    static bool appendKey(QByteArray&) {
+        return true;
+    }
+    template<typename First, typename... Rest>
+    static bool appendKey(QByteArray& key, const First& first, const Rest&... rest) {
+        if(!std::is_trivially_copyable<First>::value) {
+            return false;
+        }
+        key.append((const char*)&first, sizeof(First));
+        return appendKey(key, rest...);
+    }
+
+    // Takes the arguments as the method's parameter types, so e.g. 0 and 0L
+    // make the same key.
+    template<typename Result, typename... Parameters, typename Method>
+    QFuture<typename std::decay<Result>::type> enqueue(bool write, int priority, Method method, typename std::decay<Parameters>::type... arguments) {
+        static_assert(!HasOutputParameter<Parameters...>::value,
+                      "AsyncOverdrive can't return what a method writes to a non-const reference.");
+        typedef typename std::decay<Result>::type Value;
+
+        QByteArray key;
+        if(!write) {
+            key = methodKey(method);
+            if(!appendKey(key, arguments...)) {
+                key.clear();
+            }
+        }
+
+        QMutexLocker locker(&_mutex);
+        if(priority == MethodPriority) {
+            priority = _priorities.value(methodKey(method), NormalPriority);
+        }
+        int adapterIndex = adapterOf(arguments...);
+        int queue = queueOf(adapterIndex);
+        _counters.requests++;
+        if(!key.isEmpty()) {
+            // Same key, same method, so the request is a Call<Value>.
+            Request *identical = _reads.value(queue).value(key, 0);
+            if(identical) {
+                _counters.coalescedReads++;
+                // The shared read mustn't keep a more urgent caller waiting.
+                promote(identical, (Priority)priority);
+                return static_cast<Call<Value>*>(identical)->future();
+            }
+        }
+
+        Call<Value> *call = new Call<Value>(std::bind(method, std::placeholders::_1, arguments...));
+        call->adapterIndex = adapterIndex;
+        call->queue = queue;
+        call->priority = (Priority)priority;
+        call->write = write;
+        call->key = key;
+        QFuture<Value> future = call->future();
+        append(call);
+        return future;
+    }
+
+    // Called with the mutex held.
+    int queueOf(int adapterIndex) const;
+    // Maps adapters to the queues of their GPUs, and moves queued requests
+    // to those queues.
+    void regroup(const AdapterTopology& topology);
+    void append(Request *request);
+    // Moves a queued request to a more urgent priority.
+    void promote(Request *request, Priority priority);
+    // Inserts a request into its queue by sequence.
+    void insert(Request *request);
+    Request *takeNext();
+    void retire(Request *request);
+
+    QString _libraryPath;
+
+    mutable QMutex _mutex;
+    QWaitCondition _wakeUp;
+    bool _stopRequested;
+    QElapsedTimer _clock;
+    quint64 _nextSequence;
+    QHash<QByteArray, Priority> _priorities;
+    // Queue of each adapter index, the adapter used for calls on its GPU,
+    // as of the topology the driver thread saw last.
+    QVector<int> _gpuQueues;
+    QHash<int, QList<Request*> > _queues[NumberOfPriorities];
+    // Queues with requests per priority, in the order they take turns.
+    QList<int> _readyQueues[NumberOfPriorities];
+    // Reads that later identical reads may share, per queue.
+    QHash<int, QHash<QByteArray, Request*> > _reads;
+    int _pendingRequests;
+    Counters _counters;
+    PriorityCounters _priorityCounters[NumberOfPriorities];
+};
+
+template<>
+class AsyncOverdrive::Call<void> : public AsyncOverdrive::Request {
+public:
+    Call(const std::function<void(AMDOverdrive&)>& function) : _function(function) {
+        _interface.reportStarted();
+    }
+    void execute(AMDOverdrive& overdrive) {
+        _function(overdrive);
+    }
+    void finish() {
+        _interface.reportFinished();
+    }
+    void cancel() {
+        _interface.reportCanceled();
+        _interface.reportFinished();
+    }
+    QFuture<void> future() {
+        return _interface.future();
+    }
+
+private:
+    std::function<void(AMDOverdrive&)> _function;
+    QFutureInterface<void> _interface;
+};
@@ -0,0 +1,26 @@
+# Measures the cost of QtAMD calls against the mock ADL library. Build the
+# library (../qtamd.pro) and the mock (../mock/mock.pro) first.
+TEMPLATE = app
+
+CONFIG += console c++11
+CONFIG -= app_bundle
+TARGET = qtamd-bench
+
+SOURCES += \
+    main.cpp
+QT += core
+
+INCLUDEPATH += \
+    ..
+
+DEFINES += \
+    QTAMD_BENCH_MOCK_LIBRARY=\\\"$$OUT_PWD/../mock/libatiadlxx.so\\\"
+
+LIBS += \
+    -L$$OUT_PWD/.. -lqtamd
+
+PRE_TARGETDEPS += \
+    $$OUT_PWD/../libqtamd.a
+
+LIBS += \
+    -ldl
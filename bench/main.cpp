@@ -0,0 +1,457 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+//    This file is part of QtAMD.                                            //
+//    Copyright (C) 2015-2016 Jacob Dawid, jacob@omg-it.works                //
+//                                                                           //
+//    QtAMD is free software: you can redistribute it and/or modify          //
+//    it under the terms of the GNU Affero General Public License as         //
+//    published by the Free Software Foundation, either version 3 of the     //
+//    License, or (at your option) any later version.                        //
+//                                                                           //
+//    QtAMD is distributed in the hope that it will be useful,               //
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of         //
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          //
+//    GNU Affero General Public License for more details.                    //
+//                                                                           //
+//    You should have received a copy of the GNU General Public License      //
+//    along with QtAMD. If not, see <http://www.gnu.org/licenses/>.          //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+
+// qtamd-bench measures the latency of every public AMDOverdrive method and
+// the cost of polling whole rigs of different sizes. It runs against the
+// mock ADL library, so the numbers show QtAMD's own overhead plus whatever
+// latency the mock is told to simulate.
+//
+// Usage: qtamd-bench [--library path] [--iterations n] [--latency-us n]
+
+#include "amdoverdrive.h"
+#include "adlmemory.h"
+#include "amdmonitor.h"
+#include "asyncoverdrive.h"
+#include "parallelsweeper.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QVector>
+
+#include <algorithm>
+#include <functional>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Counting allocations. Qt containers and the library allocate through
+// malloc, so that's what is being counted.
+static volatile bool countingAllocations = false;
+static unsigned long long numberOfAllocations = 0;
+
+#if defined(__GLIBC__)
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *p, size_t size);
+void __libc_free(void *p);
+
+void *malloc(size_t size) {
+    if(countingAllocations) { __sync_fetch_and_add(&numberOfAllocations, 1); }
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size) {
+    if(countingAllocations) { __sync_fetch_and_add(&numberOfAllocations, 1); }
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *p, size_t size) {
+    if(countingAllocations) { __sync_fetch_and_add(&numberOfAllocations, 1); }
+    return __libc_realloc(p, size);
+}
+
+void free(void *p) {
+    __libc_free(p);
+}
+}
+#endif
+
+typedef unsigned long long (*NumberOfCallsFunction)();
+
+struct Statistics {
+    double p50Nanoseconds;
+    double p99Nanoseconds;
+    double allocationsPerCall;
+    double driverCallsPerCall;
+};
+
+static NumberOfCallsFunction mockNumberOfCalls = 0;
+
+static unsigned long long driverCalls() {
+    return mockNumberOfCalls ? mockNumberOfCalls() : 0;
+}
+
+static Statistics measure(int iterations, const std::function<void()>& call) {
+    // Warm up, so lazily filled caches don't show up in the numbers.
+    for(int i = 0; i < qMin(iterations, 10); i++) {
+        call();
+    }
+
+    QVector<qint64> durations(iterations);
+    QElapsedTimer timer;
+    unsigned long long callsBefore = driverCalls();
+    unsigned long long allocationsBefore = numberOfAllocations;
+
+    countingAllocations = true;
+    for(int i = 0; i < iterations; i++) {
+        timer.start();
+        call();
+        durations[i] = timer.nsecsElapsed();
+    }
+    countingAllocations = false;
+
+    Statistics statistics;
+    statistics.allocationsPerCall = double(numberOfAllocations - allocationsBefore) / iterations;
+    statistics.driverCallsPerCall = double(driverCalls() - callsBefore) / iterations;
+
+    std::sort(durations.begin(), durations.end());
+    statistics.p50Nanoseconds = durations.at(iterations / 2);
+    statistics.p99Nanoseconds = durations.at(qMin(iterations - 1, iterations * 99 / 100));
+    return statistics;
+}
+
+static void printHeader(const char *title, const char *firstColumn) {
+    printf("\n%s\n", title);
+    printf("%-34s %12s %12s %12s %12s\n", firstColumn, "p50 [us]", "p99 [us]", "allocs/call", "ADL/call");
+}
+
+static void printRow(const char *name, const Statistics& statistics) {
+    printf("%-34s %12.2f %12.2f %12.2f %12.2f\n", name,
+           statistics.p50Nanoseconds / 1000.0,
+           statistics.p99Nanoseconds / 1000.0,
+           statistics.allocationsPerCall,
+           statistics.driverCallsPerCall);
+}
+
+static void benchmarkMethods(int iterations) {
+    qputenv("QTAMD_MOCK_ADAPTERS", "1");
+    AMDOverdrive overdrive;
+    if(overdrive.activeAdapters().isEmpty()) {
+        printf("No active adapters, is the mock library loaded?\n");
+        return;
+    }
+
+    int adapter = overdrive.activeAdapters().first();
+    AdapterInfo info = overdrive.adaptersInfo().value().first();
+    ADLFanSpeedInfo fanInfo = overdrive.fanSpeedInfo(adapter, 0).value();
+    AMDOverdrive::RigSnapshot snapshot;
+    // Alternated by setters that should always reach the driver.
+    int value = 0;
+
+    // A full profile for all performance levels of the mock adapter.
+    AMDOverdrive::PerformanceLevelTransaction profile(adapter);
+    for(int level = 0; level < 3; level++) {
+        profile.setCoreClock(level, 300 + level * 100);
+        profile.setMemoryClock(level, 300 + level * 100);
+        profile.setVoltage(level, 800 + level * 50);
+    }
+
+    AMDOverdrive::PerformanceLevelInfo levels[AMDOverdrive::MaxPerformanceLevels];
+
+    struct Benchmark {
+        const char *name;
+        std::function<void()> call;
+    };
+
+    Benchmark benchmarks[] = {
+        { "numberOfAdapters", [&]() { overdrive.numberOfAdapters(); } },
+        { "adaptersInfo", [&]() { overdrive.adaptersInfo(); } },
+        { "topology", [&]() { overdrive.topology(); } },
+        { "adapterID", [&]() { overdrive.adapterID(adapter); } },
+        { "isAdapterActive", [&]() { overdrive.isAdapterActive(info); } },
+        { "capabilities", [&]() { overdrive.capabilities(adapter); } },
+        { "biosInfo", [&]() { overdrive.biosInfo(adapter); } },
+        { "metadata", [&]() { overdrive.metadata(adapter); } },
+        { "isPowerControlSupported", [&]() { overdrive.isPowerControlSupported(adapter); } },
+        { "powerControlInfo", [&]() { overdrive.powerControlInfo(adapter); } },
+        { "powerControlGetCurrent", [&]() { overdrive.powerControlGetCurrent(adapter); } },
+        { "powerControlGetDefault", [&]() { overdrive.powerControlGetDefault(adapter); } },
+        { "powerControlSet (unchanged)", [&]() { overdrive.powerControlSet(adapter, 0); } },
+        { "powerControlSet (changing)", [&]() { overdrive.powerControlSet(adapter, (value++) & 1); } },
+        { "powerControlSet (forced)", [&]() { overdrive.powerControlSet(adapter, 0, true); } },
+        { "overdriveParameters", [&]() { overdrive.overdriveParameters(adapter); } },
+        { "currentActivity", [&]() { overdrive.currentActivity(adapter); } },
+        { "performanceLevels", [&]() { overdrive.performanceLevels(adapter); } },
+        { "performanceLevels (caller buffer)", [&]() { overdrive.performanceLevels(adapter, levels, AMDOverdrive::MaxPerformanceLevels); } },
+        { "performanceLevelRange", [&]() { overdrive.performanceLevelRange(adapter, AMDOverdrive::CoreClock); } },
+        { "setCoreClock", [&]() { overdrive.setCoreClock(adapter, 0, 300); } },
+        { "setMemoryClock", [&]() { overdrive.setMemoryClock(adapter, 0, 300); } },
+        { "setVoltage", [&]() { overdrive.setVoltage(adapter, 0, 800); } },
+        { "setVoltage (out of range)", [&]() { overdrive.setVoltage(adapter, 0, 5000); } },
+        { "commit (3 levels x 3 fields)", [&]() { overdrive.commit(profile); } },
+        { "thermalControllersInfo", [&]() { overdrive.thermalControllersInfo(adapter); } },
+        { "temperatureMillidegreesCelsius", [&]() { overdrive.temperatureMillidegreesCelsius(adapter, 0); } },
+        { "fanSpeedInfo", [&]() { overdrive.fanSpeedInfo(adapter, 0); } },
+        { "fanSupportsPercentRead", [&]() { overdrive.fanSupportsPercentRead(fanInfo); } },
+        { "fanSpeedValue (rpm)", [&]() { overdrive.fanSpeedValue(adapter, 0, AMDOverdrive::Rpm); } },
+        { "fanSpeedValue (percent)", [&]() { overdrive.fanSpeedValue(adapter, 0, AMDOverdrive::Percent); } },
+        { "setFanSpeedValue (unchanged)", [&]() { overdrive.setFanSpeedValue(adapter, 0, AMDOverdrive::Percent, 40); } },
+        { "setFanSpeedValue (changing)", [&]() { overdrive.setFanSpeedValue(adapter, 0, AMDOverdrive::Percent, 40 + ((value++) & 1)); } },
+        { "setFanSpeedValue (forced)", [&]() { overdrive.setFanSpeedValue(adapter, 0, AMDOverdrive::Percent, 40, true); } },
+        { "setFanSpeedToDefault", [&]() { overdrive.setFanSpeedToDefault(adapter, 0); } },
+        { "snapshot", [&]() { overdrive.snapshot(snapshot); } }
+    };
+
+    printHeader("Per-call latency, 1 adapter", "method");
+    for(size_t i = 0; i < sizeof(benchmarks) / sizeof(Benchmark); i++) {
+        printRow(benchmarks[i].name, measure(iterations, benchmarks[i].call));
+    }
+}
+
+static void benchmarkRigs(int iterations) {
+    const int rigSizes[] = { 1, 4, 8, 16, 64 };
+
+    printHeader("Full-rig poll (snapshot)", "adapters");
+    for(size_t i = 0; i < sizeof(rigSizes) / sizeof(int); i++) {
+        qputenv("QTAMD_MOCK_ADAPTERS", QByteArray::number(rigSizes[i]));
+        AMDOverdrive overdrive;
+        AMDOverdrive::RigSnapshot snapshot;
+
+        Statistics statistics = measure(qMax(iterations / rigSizes[i], 10), [&]() { overdrive.snapshot(snapshot); });
+
+        char name[64];
+        snprintf(name, sizeof(name), "%d (%.2f us/adapter)", rigSizes[i], statistics.p50Nanoseconds / 1000.0 / rigSizes[i]);
+        printRow(name, statistics);
+    }
+
+    qputenv("QTAMD_MOCK_ADAPTERS", "8");
+    qputenv("QTAMD_MOCK_OD_VERSION", "6");
+    {
+        AMDOverdrive overdrive;
+        AMDOverdrive::RigSnapshot snapshot;
+        printRow("8, Overdrive 6", measure(iterations / 8, [&]() { overdrive.snapshot(snapshot); }));
+    }
+    qputenv("QTAMD_MOCK_OD_VERSION", "5");
+
+    // Every GPU is sampled once, not once per output.
+    qputenv("QTAMD_MOCK_OUTPUTS_PER_ADAPTER", "4");
+    {
+        AMDOverdrive overdrive;
+        AMDOverdrive::RigSnapshot snapshot;
+        printRow("8, 4 outputs each", measure(iterations / 8, [&]() { overdrive.snapshot(snapshot); }));
+    }
+    qputenv("QTAMD_MOCK_OUTPUTS_PER_ADAPTER", "1");
+}
+
+static void benchmarkParallelSweep(int iterations) {
+    // Without latency there's nothing to overlap, so simulate some unless
+    // --latency-us asked for a specific one.
+    QByteArray latency = qgetenv("QTAMD_MOCK_LATENCY_US");
+    if(latency.isEmpty() || latency == "0") {
+        qputenv("QTAMD_MOCK_LATENCY_US", "20");
+    }
+    const int rigSizes[] = { 1, 4, 8, 16 };
+
+    char title[96];
+    snprintf(title, sizeof(title), "Sweep, %s us per ADL call", qgetenv("QTAMD_MOCK_LATENCY_US").constData());
+    printHeader(title, "adapters");
+    for(size_t i = 0; i < sizeof(rigSizes) / sizeof(int); i++) {
+        qputenv("QTAMD_MOCK_ADAPTERS", QByteArray::number(rigSizes[i]));
+        int sweeps = qMax(iterations / rigSizes[i] / 4, 10);
+        char name[64];
+        {
+            AMDOverdrive overdrive;
+            AMDOverdrive::RigSnapshot snapshot;
+            snprintf(name, sizeof(name), "%d sequential", rigSizes[i]);
+            printRow(name, measure(sweeps, [&]() { overdrive.snapshot(snapshot); }));
+        }
+        {
+            // Driver calls mostly wait, so more workers than cores still help.
+            ParallelSweeper sweeper(qMax(QThread::idealThreadCount(), 8));
+            AMDOverdrive::RigSnapshot snapshot;
+            snprintf(name, sizeof(name), "%d parallel (%d workers)", rigSizes[i], sweeper.numberOfWorkers());
+            printRow(name, measure(sweeps, [&]() { sweeper.sweep(snapshot); }));
+        }
+    }
+
+    qputenv("QTAMD_MOCK_LATENCY_US", latency);
+}
+
+static void benchmarkMonitor(int iterations) {
+    qputenv("QTAMD_MOCK_ADAPTERS", "16");
+    AMDMonitor monitor;
+    // The first poll reports everything.
+    monitor.poll();
+
+    printHeader("Monitor, 16 adapters", "method");
+    printRow("poll (within deadband)", measure(iterations / 16, [&]() { monitor.poll(); }));
+}
+
+static void benchmarkTopology(int iterations) {
+    // ADL reports one adapter per display output.
+    qputenv("QTAMD_MOCK_ADAPTERS", "12");
+    qputenv("QTAMD_MOCK_OUTPUTS_PER_ADAPTER", "4");
+    AMDOverdrive overdrive;
+
+    printHeader("Adapter list, 12 devices with 4 outputs each", "method");
+    printRow("adaptersInfo", measure(iterations, [&]() { overdrive.adaptersInfo(); }));
+    printRow("topology", measure(iterations, [&]() { overdrive.topology(); }));
+
+    qputenv("QTAMD_MOCK_OUTPUTS_PER_ADAPTER", "1");
+}
+
+static void benchmarkCircuitBreakers(int iterations) {
+    // Adapters that don't support reading the temperature or the fan speed.
+    qputenv("QTAMD_MOCK_ADAPTERS", "8");
+    qputenv("QTAMD_MOCK_FAIL", "ADL_Overdrive5_Temperature_Get,ADL_Overdrive5_FanSpeed_Get");
+
+    printHeader("Full-rig poll, 8 adapters failing temperature and fan calls", "circuit breakers");
+    for(int enabled = 0; enabled < 2; enabled++) {
+        AMDOverdrive overdrive;
+        overdrive.setCircuitBreakerThreshold(enabled ? 3 : 0);
+        AMDOverdrive::RigSnapshot snapshot;
+
+        printRow(enabled ? "enabled" : "disabled", measure(iterations / 8, [&]() { overdrive.snapshot(snapshot); }));
+    }
+
+    qputenv("QTAMD_MOCK_FAIL", "");
+}
+
+static void benchmarkAsync(int iterations) {
+    qputenv("QTAMD_MOCK_ADAPTERS", "1");
+    AsyncOverdrive async;
+
+    // Handing a call to the driver thread and waiting for its result.
+    printHeader("Async calls, 1 adapter", "method");
+    printRow("read (round trip)", measure(iterations, [&]() {
+        async.read(&AMDOverdrive::temperatureMillidegreesCelsius, 0, 0).waitForFinished();
+    }));
+    printRow("write (round trip)", measure(iterations, [&]() {
+        async.write(&AMDOverdrive::powerControlSet, 0, 0, false).waitForFinished();
+    }));
+}
+
+static void benchmarkPriorities(int iterations) {
+    QByteArray latency = qgetenv("QTAMD_MOCK_LATENCY_US");
+    if(latency.isEmpty() || latency == "0") {
+        qputenv("QTAMD_MOCK_LATENCY_US", "20");
+    }
+    qputenv("QTAMD_MOCK_ADAPTERS", "32");
+    typedef ADLResult<QList<AMDOverdrive::PerformanceLevelInfo> > (AMDOverdrive::*PerformanceLevels)(int);
+    PerformanceLevels performanceLevels = &AMDOverdrive::performanceLevels;
+    int rounds = qMax(iterations / 32, 10);
+
+    // A fan speed write queued right after a performance level read of
+    // every adapter, once with its default priority and once in line.
+    char title[96];
+    snprintf(title, sizeof(title), "Priorities, 32 bulk reads then a fan write, %s us per ADL call",
+             qgetenv("QTAMD_MOCK_LATENCY_US").constData());
+    printf("\n%s\n", title);
+    printf("%-34s %12s %12s %12s\n", "request", "mean [us]", "max [us]", "peak queued");
+    for(int inLine = 0; inLine < 2; inLine++) {
+        AsyncOverdrive async;
+        if(inLine) {
+            async.setPriority(&AMDOverdrive::setFanSpeedValue, AsyncOverdrive::BulkPriority);
+        }
+        // Loads the library and caches the capabilities of every adapter.
+        for(int adapter = 0; adapter < 32; adapter++) {
+            async.read(performanceLevels, adapter).waitForFinished();
+        }
+        AsyncOverdrive::PriorityCounters warmUp = async.priorityCounters(AsyncOverdrive::BulkPriority);
+
+        QElapsedTimer timer;
+        qint64 totalWriteNanoseconds = 0;
+        qint64 maxWriteNanoseconds = 0;
+        for(int round = 0; round < rounds; round++) {
+            QList<QFuture<ADLResult<QList<AMDOverdrive::PerformanceLevelInfo> > > > reads;
+            for(int adapter = 0; adapter < 32; adapter++) {
+                reads.append(async.read(performanceLevels, adapter));
+            }
+            timer.start();
+            async.write(&AMDOverdrive::setFanSpeedValue, 0, 0, AMDOverdrive::Percent, 50, true).waitForFinished();
+            qint64 writeNanoseconds = timer.nsecsElapsed();
+            totalWriteNanoseconds += writeNanoseconds;
+            maxWriteNanoseconds = qMax(maxWriteNanoseconds, writeNanoseconds);
+            for(int i = 0; i < reads.size(); i++) {
+                reads[i].waitForFinished();
+            }
+        }
+
+        AsyncOverdrive::PriorityCounters bulk = async.priorityCounters(AsyncOverdrive::BulkPriority);
+        if(!inLine) {
+            // The maximum would include waiting for the library to load.
+            printf("%-34s %12.2f %12s %12d\n", "bulk reads (queue wait)",
+                   double(bulk.totalWaitMicroseconds - warmUp.totalWaitMicroseconds) / (bulk.executedRequests - warmUp.executedRequests),
+                   "", bulk.peakPendingRequests);
+        }
+        printf("%-34s %12.2f %12.2f %12d\n", inLine ? "fan write in line (round trip)" : "fan write, safety (round trip)",
+               totalWriteNanoseconds / 1000.0 / rounds, maxWriteNanoseconds / 1000.0,
+               inLine ? bulk.peakPendingRequests : async.priorityCounters(AsyncOverdrive::SafetyPriority).peakPendingRequests);
+    }
+
+    qputenv("QTAMD_MOCK_LATENCY_US", latency);
+}
+
+static void benchmarkLifecycle(int iterations) {
+    qputenv("QTAMD_MOCK_ADAPTERS", "8");
+
+    printHeader("Lifecycle, 8 adapters", "method");
+    printRow("AMDOverdrive()", measure(iterations / 8, [&]() { AMDOverdrive overdrive; }));
+    {
+        // Further objects share the first one's ADL context.
+        AMDOverdrive overdrive;
+        printRow("AMDOverdrive() (context shared)", measure(iterations / 8, [&]() { AMDOverdrive other; }));
+        printRow("reinitialize", measure(iterations / 8, [&]() { overdrive.reinitialize(); }));
+    }
+}
+
+static void benchmarkDriverMemory(int iterations) {
+    // What ADL_Main_Memory_Alloc costs the driver, followed by the free.
+    printHeader("Driver memory callback, 256 bytes", "allocator");
+    printRow("arena", measure(iterations, [&]() { ADLMemory::free(ADLMemory::allocate(256)); }));
+
+    ADLMemory::setAllocator(ADLMemory::heapAllocator());
+    printRow("heap", measure(iterations, [&]() { ADLMemory::free(ADLMemory::allocate(256)); }));
+    ADLMemory::setAllocator(ADLMemory::arenaAllocator());
+
+    ADLMemory::Counters counters = ADLMemory::counters();
+    printf("%llu allocations, %llu arena rewinds, %lld outstanding\n",
+           (unsigned long long)counters.allocations, (unsigned long long)counters.arenaRewinds,
+           (long long)counters.outstandingAllocations);
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication application(argc, argv);
+
+    QString library = QString::fromLocal8Bit(QTAMD_BENCH_MOCK_LIBRARY);
+    int iterations = 2000;
+    QStringList arguments = application.arguments();
+    for(int i = 1; i + 1 < arguments.size(); i++) {
+        if(arguments.at(i) == "--library") {
+            library = arguments.at(++i);
+        } else if(arguments.at(i) == "--iterations") {
+            iterations = qMax(arguments.at(++i).toInt(), 10);
+        } else if(arguments.at(i) == "--latency-us") {
+            qputenv("QTAMD_MOCK_LATENCY_US", arguments.at(++i).toLocal8Bit());
+        }
+    }
+
+    qputenv("QTAMD_ADL_LIBRARY", library.toLocal8Bit());
+    void *mock = dlopen(library.toLocal8Bit().constData(), RTLD_LAZY | RTLD_GLOBAL);
+    if(mock) {
+        mockNumberOfCalls = (NumberOfCallsFunction)dlsym(mock, "QtAMDMock_NumberOfCalls");
+    }
+    printf("ADL library: %s\n", library.toLocal8Bit().constData());
+    printf("Iterations:  %d\n", iterations);
+
+    benchmarkMethods(iterations);
+    benchmarkRigs(iterations);
+    benchmarkParallelSweep(iterations);
+    benchmarkMonitor(iterations);
+    benchmarkTopology(iterations);
+    benchmarkCircuitBreakers(iterations);
+    benchmarkLifecycle(iterations);
+    benchmarkAsync(iterations);
+    benchmarkPriorities(iterations);
+    benchmarkDriverMemory(iterations);
+    return 0;
+}
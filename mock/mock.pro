@@ -0,0 +1,12 @@
+# Fake ADL library for running QtAMD without an AMD GPU, see mockadl.cpp.
+TEMPLATE = lib
+
+CONFIG += plugin
+TARGET = atiadlxx
+
+SOURCES += \
+    mockadl.cpp
+QT += core
+
+INCLUDEPATH += \
+    ..
@@ -0,0 +1,726 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+//    This file is part of QtAMD.                                            //
+//    Copyright (C) 2015-2016 Jacob Dawid, jacob@omg-it.works                //
+//                                                                           //
+//    QtAMD is free software: you can redistribute it and/or modify          //
+//    it under the terms of the GNU Affero General Public License as         //
+//    published by the Free Software Foundation, either version 3 of the     //
+//    License, or (at your option) any later version.                        //
+//                                                                           //
+//    QtAMD is distributed in the hope that it will be useful,               //
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of         //
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          //
+//    GNU Affero General Public License for more details.                    //
+//                                                                           //
+//    You should have received a copy of the GNU General Public License      //
+//    along with QtAMD. If not, see <http://www.gnu.org/licenses/>.          //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+
+// A fake ADL library, built as libatiadlxx.so. It simulates a rig of AMD
+// adapters so QtAMD can be tested and benchmarked without a GPU. The rig is
+// configured with environment variables, which are read on every call to
+// ADL_Main_Control_Create:
+//
+//   QTAMD_MOCK_ADAPTERS                Number of physical GPUs (default 1).
+//   QTAMD_MOCK_OUTPUTS_PER_ADAPTER     Logical adapters per GPU (default 1).
+//   QTAMD_MOCK_OD_VERSION              Overdrive version, 5 or 6 (default 5).
+//   QTAMD_MOCK_THERMAL_CONTROLLERS     Thermal controllers per GPU (default 1).
+//   QTAMD_MOCK_PERFORMANCE_LEVELS      OD5 performance levels, 1 to 16 (default 3).
+//   QTAMD_MOCK_LATENCY_US              Latency added to every call (default 0).
+//   QTAMD_MOCK_ENGINE_CLOCK_MIN        Engine clock range in 10 kHz (default
+//   QTAMD_MOCK_ENGINE_CLOCK_MAX        30000 to 150000).
+//   QTAMD_MOCK_DESTROY_LATENCY_US      Time ADL_Main_Control_Destroy takes,
+//                                      read on every call (default 0).
+//   QTAMD_MOCK_FAIL                    Comma separated names of functions
+//                                      that fail with ADL_ERR_NOT_SUPPORTED.
+//                                      ADL_Main_Control_Create fails both
+//                                      legacy and ADL2 context creation.
+//
+// Every entry point also exists as its ADL2 variant, which takes a context
+// handle created by ADL2_Main_Control_Create first.
+
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifndef LINUX
+#   define LINUX
+#endif
+
+#include "adl/adl_sdk.h"
+#include "adl/adl_structures.h"
+#include "adlfunctionpointers.h"
+#include "adlresult.h"
+
+#include <algorithm>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#define MOCK_EXPORT extern "C" __attribute__((visibility("default")))
+
+namespace {
+
+// More than QtAMD keeps on the stack, so the heap path can be tested.
+const int MaxMockPerformanceLevels = 16;
+
+struct MockAdapter {
+    int od5Levels;
+    ADLODPerformanceLevel defaultLevels[MaxMockPerformanceLevels];
+    ADLODPerformanceLevel currentLevels[MaxMockPerformanceLevels];
+    ADLOD6PerformanceLevel od6DefaultLevels[2];
+    ADLOD6PerformanceLevel od6CurrentLevels[2];
+    int temperature;
+    int fanPercent;
+    int fanRpm;
+    bool fanUserDefined;
+    int powerControl;
+    int activity;
+};
+
+struct MockRig {
+    bool initialized;
+    int adapters;
+    int outputsPerAdapter;
+    int overdriveVersion;
+    int thermalControllers;
+    int performanceLevels;
+    int latencyMicroseconds;
+    ADLODParameterRange engineClockRange;
+    std::vector<std::string> failing;
+    std::vector<MockAdapter> gpus;
+    unsigned long long calls;
+    // Calls on the global context rather than through ADL2.
+    unsigned long long legacyCalls;
+    // ADL_Main_Control_Create calls.
+    unsigned long long initializations;
+    // Live ADL2 contexts.
+    std::set<ADL_CONTEXT_HANDLE> contexts;
+    uintptr_t lastContext;
+};
+
+std::mutex mutex;
+MockRig rig = { false, 0, 0, 0, 0, 0, 0, { 0, 0, 0 }, std::vector<std::string>(), std::vector<MockAdapter>(), 0, 0, 0, std::set<ADL_CONTEXT_HANDLE>(), 0 };
+
+const ADLODParameterRange memoryClockRange = { 30000, 250000, 500 };
+const ADLODParameterRange vddcRange = { 800, 1300, 5 };
+
+int environmentValue(const char *name, int defaultValue) {
+    const char *value = getenv(name);
+    return value ? atoi(value) : defaultValue;
+}
+
+void setFailing(const char *failing) {
+    rig.failing.clear();
+    if(failing) {
+        std::string names(failing);
+        size_t start = 0;
+        while(start <= names.size()) {
+            size_t end = names.find(',', start);
+            if(end == std::string::npos) { end = names.size(); }
+            if(end > start) { rig.failing.push_back(names.substr(start, end - start)); }
+            start = end + 1;
+        }
+    }
+}
+
+void configure() {
+    rig.adapters = environmentValue("QTAMD_MOCK_ADAPTERS", 1);
+    rig.outputsPerAdapter = environmentValue("QTAMD_MOCK_OUTPUTS_PER_ADAPTER", 1);
+    rig.overdriveVersion = environmentValue("QTAMD_MOCK_OD_VERSION", 5);
+    rig.thermalControllers = environmentValue("QTAMD_MOCK_THERMAL_CONTROLLERS", 1);
+    rig.performanceLevels = environmentValue("QTAMD_MOCK_PERFORMANCE_LEVELS", 3);
+    rig.latencyMicroseconds = environmentValue("QTAMD_MOCK_LATENCY_US", 0);
+    rig.engineClockRange.iMin = environmentValue("QTAMD_MOCK_ENGINE_CLOCK_MIN", 30000);
+    rig.engineClockRange.iMax = environmentValue("QTAMD_MOCK_ENGINE_CLOCK_MAX", 150000);
+    rig.engineClockRange.iStep = 500;
+
+    if(rig.adapters < 0) { rig.adapters = 0; }
+    if(rig.outputsPerAdapter < 1) { rig.outputsPerAdapter = 1; }
+    if(rig.performanceLevels < 1) { rig.performanceLevels = 1; }
+    if(rig.performanceLevels > MaxMockPerformanceLevels) { rig.performanceLevels = MaxMockPerformanceLevels; }
+
+    setFailing(getenv("QTAMD_MOCK_FAIL"));
+
+    rig.gpus.assign(rig.adapters, MockAdapter());
+    for(int i = 0; i < rig.adapters; i++) {
+        MockAdapter& gpu = rig.gpus[i];
+        memset(&gpu, 0, sizeof(MockAdapter));
+        gpu.od5Levels = rig.performanceLevels;
+        for(int level = 0; level < gpu.od5Levels; level++) {
+            int step = gpu.od5Levels > 1 ? level * 100 / (gpu.od5Levels - 1) : 100;
+            gpu.defaultLevels[level].iEngineClock = std::min(std::max(30000 + step * 1000, rig.engineClockRange.iMin), rig.engineClockRange.iMax);
+            gpu.defaultLevels[level].iMemoryClock = 30000 + step * 1700;
+            gpu.defaultLevels[level].iVddc = 800 + step * 3;
+            gpu.currentLevels[level] = gpu.defaultLevels[level];
+        }
+        gpu.od6DefaultLevels[0].iEngineClock = rig.engineClockRange.iMin;
+        gpu.od6DefaultLevels[0].iMemoryClock = 30000;
+        gpu.od6DefaultLevels[1].iEngineClock = std::min(130000, rig.engineClockRange.iMax);
+        gpu.od6DefaultLevels[1].iMemoryClock = 200000;
+        gpu.od6CurrentLevels[0] = gpu.od6DefaultLevels[0];
+        gpu.od6CurrentLevels[1] = gpu.od6DefaultLevels[1];
+        gpu.temperature = 60000 + i * 500;
+        gpu.fanPercent = 40;
+        gpu.fanRpm = 1600;
+        gpu.activity = 95;
+    }
+}
+
+// Set while an ADL2 entry point forwards to the legacy one, whose latency
+// has already been simulated without holding the lock.
+thread_local bool inADL2Call = false;
+
+// Guards every entry point: serializes access to the rig, counts the call,
+// simulates latency and injected failures.
+class Call {
+public:
+    Call(const char *name) : _lock(mutex), _failing(false) {
+        rig.calls++;
+        if(!inADL2Call) {
+            rig.legacyCalls++;
+        }
+        if(rig.latencyMicroseconds > 0 && !inADL2Call) {
+            usleep(rig.latencyMicroseconds);
+        }
+        // Compared without building a std::string, so calls don't allocate.
+        for(size_t i = 0; i < rig.failing.size() && !_failing; i++) {
+            _failing = strcmp(rig.failing[i].c_str(), name) == 0;
+        }
+    }
+
+    // Returns ADL_OK if the call may proceed, an error code otherwise.
+    int check(int adapterIndex = 0, int overdriveVersion = 0) const {
+        if(!rig.initialized && rig.contexts.empty()) { return ADL_ERR_NOT_INIT; }
+        if(_failing) { return ADL_ERR_NOT_SUPPORTED; }
+        if(adapterIndex < 0 || adapterIndex >= rig.adapters * rig.outputsPerAdapter) { return ADL_ERR_INVALID_ADL_IDX; }
+        if(overdriveVersion && overdriveVersion != rig.overdriveVersion) { return ADL_ERR_NOT_SUPPORTED; }
+        return ADL_OK;
+    }
+
+private:
+    std::lock_guard<std::mutex> _lock;
+    bool _failing;
+};
+
+MockAdapter& gpu(int adapterIndex) {
+    return rig.gpus[adapterIndex / rig.outputsPerAdapter];
+}
+
+// Adds a bit of jitter, so consecutive readings aren't all the same.
+int jitter(int value, int amplitude) {
+    return value + (int)(rig.calls % 3) * amplitude - amplitude;
+}
+
+bool inRange(int value, const ADLODParameterRange& range) {
+    return value >= range.iMin && value <= range.iMax;
+}
+
+}
+
+#define MOCK_CALL(name, adapterIndex, overdriveVersion) \
+    Call call(#name); \
+    int returnCode = call.check(adapterIndex, overdriveVersion); \
+    if(returnCode != ADL_OK) { return returnCode; }
+
+// Main
+
+// Read from the environment on every call, as the rig may already be
+// configured.
+static bool creationFails() {
+    const char *failing = getenv("QTAMD_MOCK_FAIL");
+    return failing && strstr(failing, "ADL_Main_Control_Create") != 0;
+}
+
+MOCK_EXPORT int ADL_Main_Control_Create(ADL_MAIN_MALLOC_CALLBACK callback, int iEnumConnectedAdapters) {
+    (void)iEnumConnectedAdapters;
+    std::lock_guard<std::mutex> lock(mutex);
+    if(!callback) { return ADL_ERR_INVALID_CALLBACK; }
+    if(creationFails()) { return ADL_ERR_NOT_SUPPORTED; }
+    configure();
+    rig.initialized = true;
+    rig.initializations++;
+    return ADL_OK;
+}
+
+MOCK_EXPORT int ADL_Main_Control_Destroy() {
+    // Without holding the lock, so other calls can run in the meantime.
+    int latencyMicroseconds = environmentValue("QTAMD_MOCK_DESTROY_LATENCY_US", 0);
+    if(latencyMicroseconds > 0) {
+        usleep(latencyMicroseconds);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    rig.initialized = false;
+    return ADL_OK;
+}
+
+// Adapters
+
+MOCK_EXPORT int ADL_Adapter_NumberOfAdapters_Get(int *lpNumAdapters) {
+    MOCK_CALL(ADL_Adapter_NumberOfAdapters_Get, 0, 0)
+    *lpNumAdapters = rig.adapters * rig.outputsPerAdapter;
+    return ADL_OK;
+}
+
+MOCK_EXPORT int ADL_Adapter_AdapterInfo_Get(LPAdapterInfo lpInfo, int iInputSize) {
+    MOCK_CALL(ADL_Adapter_AdapterInfo_Get, 0, 0)
+    int n = rig.adapters * rig.outputsPerAdapter;
+    if(!lpInfo) { return ADL_ERR_NULL_POINTER; }
+    if(iInputSize < (int)sizeof(AdapterInfo) * n) { return ADL_ERR_INVALID_PARAM_SIZE; }
+    for(int i = 0; i < n; i++) {
+        int physical = i / rig.outputsPerAdapter;
+        AdapterInfo& info = lpInfo[i];
+        memset(&info, 0, sizeof(AdapterInfo));
+        info.iSize = sizeof(AdapterInfo);
+        info.iAdapterIndex = i;
+        snprintf(info.strUDID, ADL_MAX_PATH, "PCI_VEN_1002&DEV_67DF&SUBSYS_0B311002&REV_C7_%d", physical);
+        info.iBusNumber = physical + 1;
+        info.iDeviceNumber = 0;
+        info.iFunctionNumber = 0;
+        info.iVendorID = 1002;
+        snprintf(info.strAdapterName, ADL_MAX_PATH, "Mock Radeon %s", rig.overdriveVersion == 6 ? "OD6" : "OD5");
+        snprintf(info.strDisplayName, ADL_MAX_PATH, ":0.%d", i);
+        info.iPresent = 1;
+        info.iXScreenNum = i;
+        info.iDrvIndex = physical;
+        snprintf(info.strXScreenConfigName, ADL_MAX_PATH, "amdcccle-screen%d", i);
+    }
+    return ADL_OK;
+}
+
+MOCK_EXPORT int ADL_Adapter_Active_Get(int iAdapterIndex, int *lpStatus) {
+    MOCK_CALL(ADL_Adapter_Active_Get, iAdapterIndex, 0)
+    *lpStatus = 1;
+    return ADL_OK;
+}
+
+MOCK_EXPORT int ADL_Adapter_ID_Get(int iAdapterIndex, int *lpAdapterID) {
+    MOCK_CALL(ADL_Adapter_ID_Get, iAdapterIndex, 0)
+    *lpAdapterID = 0x1000 + iAdapterIndex / rig.outputsPerAdapter;
+    return ADL_OK;
+}
+
+MOCK_EXPORT int ADL_Adapter_VideoBiosInfo_Get(int iAdapterIndex, ADLBiosInfo *lpBiosInfo) {
+    MOCK_CALL(ADL_Adapter_VideoBiosInfo_Get, iAdapterIndex, 0)
+    memset(lpBiosInfo, 0, sizeof(ADLBiosInfo));
+    snprintf(lpBiosInfo->strPartNumber, ADL_MAX_PATH, "113-MOCK-%03d", iAdapterIndex / rig.outputsPerAdapter);
+    snprintf(lpBiosInfo->strVersion, ADL_MAX_PATH, "015.050.002.001.000000");
+    snprintf(lpBiosInfo->strDate, ADL_MAX_PATH, "2016/01/01 00:00");
+    return ADL_OK;
+}
+
+MOCK_EXPORT int ADL_Overdrive_Caps(int iAdapterIndex, int *iSupported, int *iEnabled, int *iVersion) {
+    MOCK_CALL(ADL_Overdrive_Caps, iAdapterIndex, 0)
+    *iSupported = 1;
+    *iEnabled = 1;
+    *iVersion = rig.overdriveVersion;
+    return ADL_OK;
+}
+
+// Overdrive 5
+
+MOCK_EXPORT int ADL_Overdrive5_ThermalDevices_Enum(int iAdapterIndex, int iThermalControllerIndex, ADLThermalControllerInfo *lpThermalControllerInfo) {
+    MOCK_CALL(ADL_Overdrive5_ThermalDevices_Enum, iAdapterIndex, 5)
+    if(iThermalControllerIndex < 0 || iThermalControllerIndex >= rig.thermalControllers) { return ADL_WARNING_NO_DATA; }
+    lpThermalControllerInfo->iThermalDomain = ADL_DL_THERMAL_DOMAIN_GPU;
+    lpThermalControllerInfo->iDomainIndex = iAdapterIndex / rig.outputsPerAdapter;
+    lpThermalControllerInfo->iFlags = ADL_DL_THERMAL_FLAG_FANCONTROL;
+    return ADL_OK;
+}
+
+MOCK_EXPORT int ADL_Overdrive5_ODParameters_Get(int iAdapterIndex, ADLODParameters *lpOdParameters) {
+    MOCK_CALL(ADL_Overdrive5_ODParameters_Get, iAdapterIndex, 5)
+    lpOdParameters->iNumberOfPerformanceLevels = gpu(iAdapterIndex).od5Levels;
+    lpOdParameters->iActivityReportingSupported = 1;
+    lpOdParameters->iDiscretePerformanceLevels = 1;
+    lpOdParameters->sEngineClock = rig.engineClockRange;
+    lpOdParameters->sMemoryClock = memoryClockRange;
+    lpOdParameters->sVddc = vddcRange;
+    return ADL_OK;
+}
+
+MOCK_EXPORT int ADL_Overdrive5_Temperature_Get(int iAdapterIndex, int iThermalControllerIndex, ADLTemperature *lpTemperature) {
+    MOCK_CALL(ADL_Overdrive5_Temperature_Get, iAdapterIndex, 5)
+    if(iThermalControllerIndex < 0 || iThermalControllerIndex >= rig.thermalControllers) { return ADL_ERR_INVALID_CONTROLLER_IDX; }
+    lpTemperature->iTemperature = jitter(gpu(iAdapterIndex).temperature, 250);
+    return ADL_OK;
+}
+
+MOCK_EXPORT int ADL_Overdrive5_FanSpeed_Get(int iAdapterIndex, int iThermalControllerIndex, ADLFanSpeedValue *lpFanSpeedValue) {
+    MOCK_CALL(ADL_Overdrive5_FanSpeed_Get, iAdapterIndex, 5)
+    if(iThermalControllerIndex < 0 || iThermalControllerIndex >= rig.thermalControllers) { return ADL_ERR_INVALID_CONTROLLER_IDX; }
+    const MockAdapter& adapter = gpu(iAdapterIndex);
+    lpFanSpeedValue->iFanSpeed = lpFanSpeedValue->iSpeedType == ADL_DL_FANCTRL_SPEED_TYPE_RPM ? adapter.fanRpm : adapter.fanPercent;
+    lpFanSpeedValue->iFlags = adapter.fanUserDefined ? ADL_DL_FANCTRL_FLAG_USER_DEFINED_SPEED : 0;
+    return ADL_OK;
+}
+
+MOCK_EXPORT int ADL_Overdrive5_FanSpeedInfo_Get(int iAdapterIndex, int iThermalControllerIndex, ADLFanSpeedInfo *lpFanSpeedInfo) {
+    MOCK_CALL(ADL_Overdrive5_FanSpeedInfo_Get, iAdapterIndex, 5)
+    if(iThermalControllerIndex < 0 || iThermalControllerIndex >= rig.thermalControllers) { return ADL_ERR_INVALID_CONTROLLER_IDX; }
+    lpFanSpeedInfo->iFlags = ADL_DL_FANCTRL_SUPPORTS_PERCENT_READ | ADL_DL_FANCTRL_SUPPORTS_PERCENT_WRITE
+                           | ADL_DL_FANCTRL_SUPPORTS_RPM_READ | ADL_DL_FANCTRL_SUPPORTS_RPM_WRITE;
+    lpFanSpeedInfo->iMinPercent = 0;
+    lpFanSpeedInfo->iMaxPercent = 100;
+    lpFanSpeedInfo->iMinRPM = 0;
+    lpFanSpeedInfo->iMaxRPM = 4000;
+    return ADL_OK;
+}
+
+MOCK_EXPORT int ADL_Overdrive5_ODPerformanceLevels_Get(int iAdapterIndex, int iDefault, ADLODPerformanceLevels *lpOdPerformanceLevels) {
+    MOCK_CALL(ADL_Overdrive5_ODPerformanceLevels_Get, iAdapterIndex, 5)
+    const MockAdapter& adapter = gpu(iAdapterIndex);
+    int size = sizeof(ADLODPerformanceLevels) + sizeof(ADLODPerformanceLevel) * (adapter.od5Levels - 1);
+    if(lpOdPerformanceLevels->iSize < size) { return ADL_ERR_INVALID_PARAM_SIZE; }
+    for(int i = 0; i < adapter.od5Levels; i++) {
+        lpOdPerformanceLevels->aLevels[i] = iDefault ? adapter.defaultLevels[i] : adapter.currentLevels[i];
+    }
+    return ADL_OK;
+}
+
+MOCK_EXPORT int ADL_Overdrive5_CurrentActivity_Get(int iAdapterIndex, ADLPMActivity *lpActivity) {
+    MOCK_CALL(ADL_Overdrive5_CurrentActivity_Get, iAdapterIndex, 5)
+    const MockAdapter& adapter = gpu(iAdapterIndex);
+    const ADLODPerformanceLevel& level = adapter.currentLevels[adapter.od5Levels - 1];
+    lpActivity->iEngineClock = level.iEngineClock;
+    lpActivity->iMemoryClock = level.iMemoryClock;
+    lpActivity->iVddc = level.iVddc;
+    lpActivity->iActivityPercent = jitter(adapter.activity, 1);
+    lpActivity->iCurrentPerformanceLevel = adapter.od5Levels - 1;
+    lpActivity->iCurrentBusSpeed = 8000;
+    lpActivity->iCurrentBusLanes = 16;
+    lpActivity->iMaximumBusLanes = 16;
+    return ADL_OK;
+}
+
+MOCK_EXPORT int ADL_Overdrive5_FanSpeed_Set(int iAdapterIndex, int iThermalControllerIndex, ADLFanSpeedValue *lpFanSpeedValue) {
+    MOCK_CALL(ADL_Overdrive5_FanSpeed_Set, iAdapterIndex, 5)
+    if(iThermalControllerIndex < 0 || iThermalControllerIndex >= rig.thermalControllers) { return ADL_ERR_INVALID_CONTROLLER_IDX; }
+    MockAdapter& adapter = gpu(iAdapterIndex);
+    if(lpFanSpeedValue->iSpeedType == ADL_DL_FANCTRL_SPEED_TYPE_RPM) {
+        if(lpFanSpeedValue->iFanSpeed < 0 || lpFanSpeedValue->iFanSpeed > 4000) { return ADL_ERR_INVALID_PARAM; }
+        adapter.fanRpm = lpFanSpeedValue->iFanSpeed;
+        adapter.fanPercent = adapter.fanRpm / 40;
+    } else {
+        if(lpFanSpeedValue->iFanSpeed < 0 || lpFanSpeedValue->iFanSpeed > 100) { return ADL_ERR_INVALID_PARAM; }
+        adapter.fanPercent = lpFanSpeedValue->iFanSpeed;
+        adapter.fanRpm = adapter.fanPercent * 40;
+    }
+    adapter.fanUserDefined = true;
+    return ADL_OK;
+}
+
+MOCK_EXPORT int ADL_Overdrive5_FanSpeedToDefault_Set(int iAdapterIndex, int iThermalControllerIndex) {
+    MOCK_CALL(ADL_Overdrive5_FanSpeedToDefault_Set, iAdapterIndex, 5)
+    if(iThermalControllerIndex < 0 || iThermalControllerIndex >= rig.thermalControllers) { return ADL_ERR_INVALID_CONTROLLER_IDX; }
+    MockAdapter& adapter = gpu(iAdapterIndex);
+    adapter.fanPercent = 40;
+    adapter.fanRpm = 1600;
+    adapter.fanUserDefined = false;
+    return ADL_OK;
+}
+
+MOCK_EXPORT int ADL_Overdrive5_ODPerformanceLevels_Set(int iAdapterIndex, ADLODPerformanceLevels *lpOdPerformanceLevels) {
+    MOCK_CALL(ADL_Overdrive5_ODPerformanceLevels_Set, iAdapterIndex, 5)
+    MockAdapter& adapter = gpu(iAdapterIndex);
+    int size = sizeof(ADLODPerformanceLevels) + sizeof(ADLODPerformanceLevel) * (adapter.od5Levels - 1);
+    if(lpOdPerformanceLevels->iSize < size) { return ADL_ERR_INVALID_PARAM_SIZE; }
+    for(int i = 0; i < adapter.od5Levels; i++) {
+        const ADLODPerformanceLevel& level = lpOdPerformanceLevels->aLevels[i];
+        if(!inRange(level.iEngineClock, rig.engineClockRange)
+        || !inRange(level.iMemoryClock, memoryClockRange)
+        || !inRange(level.iVddc, vddcRange)) {
+            return ADL_ERR_INVALID_PARAM;
+        }
+    }
+    for(int i = 0; i < adapter.od5Levels; i++) {
+        adapter.currentLevels[i] = lpOdPerformanceLevels->aLevels[i];
+    }
+    return ADL_OK;
+}
+
+MOCK_EXPORT int ADL_Overdrive5_PowerControl_Caps(int iAdapterIndex, int *lpSupported) {
+    MOCK_CALL(ADL_Overdrive5_PowerControl_Caps, iAdapterIndex, 5)
+    *lpSupported = 1;
+    return ADL_OK;
+}
+
+MOCK_EXPORT int ADL_Overdrive5_PowerControlInfo_Get(int iAdapterIndex, ADLPowerControlInfo *lpPowerControlInfo) {
+    MOCK_CALL(ADL_Overdrive5_PowerControlInfo_Get, iAdapterIndex, 5)
+    lpPowerControlInfo->iMinValue = -50;
+    lpPowerControlInfo->iMaxValue = 50;
+    lpPowerControlInfo->iStepValue = 1;
+    return ADL_OK;
+}
+
+MOCK_EXPORT int ADL_Overdrive5_PowerControl_Get(int iAdapterIndex, int *lpCurrentValue, int *lpDefaultValue) {
+    MOCK_CALL(ADL_Overdrive5_PowerControl_Get, iAdapterIndex, 5)
+    *lpCurrentValue = gpu(iAdapterIndex).powerControl;
+    *lpDefaultValue = 0;
+    return ADL_OK;
+}
+
+MOCK_EXPORT int ADL_Overdrive5_PowerControl_Set(int iAdapterIndex, int iValue) {
+    MOCK_CALL(ADL_Overdrive5_PowerControl_Set, iAdapterIndex, 5)
+    if(iValue < -50 || iValue > 50) { return ADL_ERR_INVALID_PARAM; }
+    gpu(iAdapterIndex).powerControl = iValue;
+    return ADL_OK;
+}
+
+// Overdrive 6
+
+MOCK_EXPORT int ADL_Overdrive6_FanSpeed_Get(int iAdapterIndex, ADLOD6FanSpeedInfo *lpFanSpeedInfo) {
+    MOCK_CALL(ADL_Overdrive6_FanSpeed_Get, iAdapterIndex, 6)
+    const MockAdapter& adapter = gpu(iAdapterIndex);
+    lpFanSpeedInfo->iSpeedType = ADL_OD6_FANSPEED_TYPE_PERCENT | ADL_OD6_FANSPEED_TYPE_RPM
+                               | (adapter.fanUserDefined ? ADL_OD6_FANSPEED_USER_DEFINED : 0);
+    lpFanSpeedInfo->iFanSpeedPercent = adapter.fanPercent;
+    lpFanSpeedInfo->iFanSpeedRPM = adapter.fanRpm;
+    return ADL_OK;
+}
+
+MOCK_EXPORT int ADL_Overdrive6_ThermalController_Caps(int iAdapterIndex, ADLOD6ThermalControllerCaps *lpThermalControllerCaps) {
+    MOCK_CALL(ADL_Overdrive6_ThermalController_Caps, iAdapterIndex, 6)
+    lpThermalControllerCaps->iCapabilities = ADL_OD6_TCCAPS_THERMAL_CONTROLLER | ADL_OD6_TCCAPS_FANSPEED_CONTROL
+                                           | ADL_OD6_TCCAPS_FANSPEED_PERCENT_READ | ADL_OD6_TCCAPS_FANSPEED_PERCENT_WRITE
+                                           | ADL_OD6_TCCAPS_FANSPEED_RPM_READ | ADL_OD6_TCCAPS_FANSPEED_RPM_WRITE;
+    lpThermalControllerCaps->iFanMinPercent = 0;
+    lpThermalControllerCaps->iFanMaxPercent = 100;
+    lpThermalControllerCaps->iFanMinRPM = 0;
+    lpThermalControllerCaps->iFanMaxRPM = 4000;
+    return ADL_OK;
+}
+
+MOCK_EXPORT int ADL_Overdrive6_Temperature_Get(int iAdapterIndex, int *lpTemperature) {
+    MOCK_CALL(ADL_Overdrive6_Temperature_Get, iAdapterIndex, 6)
+    *lpTemperature = jitter(gpu(iAdapterIndex).temperature, 250);
+    return ADL_OK;
+}
+
+MOCK_EXPORT int ADL_Overdrive6_Capabilities_Get(int iAdapterIndex, ADLOD6Capabilities *lpODCapabilities) {
+    MOCK_CALL(ADL_Overdrive6_Capabilities_Get, iAdapterIndex, 6)
+    memset(lpODCapabilities, 0, sizeof(ADLOD6Capabilities));
+    lpODCapabilities->iCapabilities = ADL_OD6_CAPABILITY_SCLK_CUSTOMIZATION | ADL_OD6_CAPABILITY_MCLK_CUSTOMIZATION
+                                    | ADL_OD6_CAPABILITY_GPU_ACTIVITY_MONITOR | ADL_OD6_CAPABILITY_POWER_CONTROL;
+    lpODCapabilities->iSupportedStates = ADL_OD6_SUPPORTEDSTATE_PERFORMANCE;
+    lpODCapabilities->iNumberOfPerformanceLevels = 2;
+    lpODCapabilities->sEngineClockRange.iMin = rig.engineClockRange.iMin;
+    lpODCapabilities->sEngineClockRange.iMax = rig.engineClockRange.iMax;
+    lpODCapabilities->sEngineClockRange.iStep = rig.engineClockRange.iStep;
+    lpODCapabilities->sMemoryClockRange.iMin = memoryClockRange.iMin;
+    lpODCapabilities->sMemoryClockRange.iMax = memoryClockRange.iMax;
+    lpODCapabilities->sMemoryClockRange.iStep = memoryClockRange.iStep;
+    return ADL_OK;
+}
+
+MOCK_EXPORT int ADL_Overdrive6_StateInfo_Get(int iAdapterIndex, int iStateType, ADLOD6StateInfo *lpStateInfo) {
+    MOCK_CALL(ADL_Overdrive6_StateInfo_Get, iAdapterIndex, 6)
+    const MockAdapter& adapter = gpu(iAdapterIndex);
+    bool useDefault = iStateType == ADL_OD6_GETSTATEINFO_DEFAULT_PERFORMANCE;
+    lpStateInfo->iNumberOfPerformanceLevels = 2;
+    for(int i = 0; i < 2; i++) {
+        lpStateInfo->aLevels[i] = useDefault ? adapter.od6DefaultLevels[i] : adapter.od6CurrentLevels[i];
+    }
+    return ADL_OK;
+}
+
+MOCK_EXPORT int ADL_Overdrive6_CurrentStatus_Get(int iAdapterIndex, ADLOD6CurrentStatus *lpCurrentStatus) {
+    MOCK_CALL(ADL_Overdrive6_CurrentStatus_Get, iAdapterIndex, 6)
+    const MockAdapter& adapter = gpu(iAdapterIndex);
+    memset(lpCurrentStatus, 0, sizeof(ADLOD6CurrentStatus));
+    lpCurrentStatus->iEngineClock = adapter.od6CurrentLevels[1].iEngineClock;
+    lpCurrentStatus->iMemoryClock = adapter.od6CurrentLevels[1].iMemoryClock;
+    lpCurrentStatus->iActivityPercent = jitter(adapter.activity, 1);
+    lpCurrentStatus->iCurrentBusSpeed = 8000;
+    lpCurrentStatus->iCurrentBusLanes = 16;
+    lpCurrentStatus->iMaximumBusLanes = 16;
+    return ADL_OK;
+}
+
+MOCK_EXPORT int ADL_Overdrive6_PowerControl_Caps(int iAdapterIndex, int *lpSupported) {
+    MOCK_CALL(ADL_Overdrive6_PowerControl_Caps, iAdapterIndex, 6)
+    *lpSupported = 1;
+    return ADL_OK;
+}
+
+MOCK_EXPORT int ADL_Overdrive6_PowerControlInfo_Get(int iAdapterIndex, ADLOD6PowerControlInfo *lpPowerControlInfo) {
+    MOCK_CALL(ADL_Overdrive6_PowerControlInfo_Get, iAdapterIndex, 6)
+    memset(lpPowerControlInfo, 0, sizeof(ADLOD6PowerControlInfo));
+    lpPowerControlInfo->iMinValue = -50;
+    lpPowerControlInfo->iMaxValue = 50;
+    lpPowerControlInfo->iStepValue = 1;
+    return ADL_OK;
+}
+
+MOCK_EXPORT int ADL_Overdrive6_PowerControl_Get(int iAdapterIndex, int *lpCurrentValue, int *lpDefaultValue) {
+    MOCK_CALL(ADL_Overdrive6_PowerControl_Get, iAdapterIndex, 6)
+    *lpCurrentValue = gpu(iAdapterIndex).powerControl;
+    *lpDefaultValue = 0;
+    return ADL_OK;
+}
+
+MOCK_EXPORT int ADL_Overdrive6_FanSpeed_Set(int iAdapterIndex, ADLOD6FanSpeedValue *lpFanSpeedValue) {
+    MOCK_CALL(ADL_Overdrive6_FanSpeed_Set, iAdapterIndex, 6)
+    MockAdapter& adapter = gpu(iAdapterIndex);
+    if(lpFanSpeedValue->iSpeedType == ADL_OD6_FANSPEED_TYPE_RPM) {
+        if(lpFanSpeedValue->iFanSpeed < 0 || lpFanSpeedValue->iFanSpeed > 4000) { return ADL_ERR_INVALID_PARAM; }
+        adapter.fanRpm = lpFanSpeedValue->iFanSpeed;
+        adapter.fanPercent = adapter.fanRpm / 40;
+    } else {
+        if(lpFanSpeedValue->iFanSpeed < 0 || lpFanSpeedValue->iFanSpeed > 100) { return ADL_ERR_INVALID_PARAM; }
+        adapter.fanPercent = lpFanSpeedValue->iFanSpeed;
+        adapter.fanRpm = adapter.fanPercent * 40;
+    }
+    adapter.fanUserDefined = true;
+    return ADL_OK;
+}
+
+MOCK_EXPORT int ADL_Overdrive6_State_Set(int iAdapterIndex, int iStateType, ADLOD6StateInfo *lpStateInfo) {
+    MOCK_CALL(ADL_Overdrive6_State_Set, iAdapterIndex, 6)
+    if(iStateType != ADL_OD6_SETSTATE_PERFORMANCE) { return ADL_ERR_INVALID_PARAM; }
+    if(lpStateInfo->iNumberOfPerformanceLevels != 2) { return ADL_ERR_INVALID_PARAM; }
+    for(int i = 0; i < 2; i++) {
+        if(!inRange(lpStateInfo->aLevels[i].iEngineClock, rig.engineClockRange)
+        || !inRange(lpStateInfo->aLevels[i].iMemoryClock, memoryClockRange)) {
+            return ADL_ERR_INVALID_PARAM;
+        }
+    }
+    MockAdapter& adapter = gpu(iAdapterIndex);
+    adapter.od6CurrentLevels[0] = lpStateInfo->aLevels[0];
+    adapter.od6CurrentLevels[1] = lpStateInfo->aLevels[1];
+    return ADL_OK;
+}
+
+MOCK_EXPORT int ADL_Overdrive6_PowerControl_Set(int iAdapterIndex, int iValue) {
+    MOCK_CALL(ADL_Overdrive6_PowerControl_Set, iAdapterIndex, 6)
+    if(iValue < -50 || iValue > 50) { return ADL_ERR_INVALID_PARAM; }
+    gpu(iAdapterIndex).powerControl = iValue;
+    return ADL_OK;
+}
+
+// ADL2: the same entry points on a context handle. Contexts don't have
+// any state of their own, they only have to be alive.
+
+// Contexts are independent, so unlike legacy calls, ADL2 calls on
+// different contexts wait for the simulated latency at the same time.
+static bool enterContext(ADL_CONTEXT_HANDLE context) {
+    int latencyMicroseconds;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(rig.contexts.count(context) == 0) { return false; }
+        latencyMicroseconds = rig.latencyMicroseconds;
+    }
+    if(latencyMicroseconds > 0) {
+        usleep(latencyMicroseconds);
+    }
+    return true;
+}
+
+class ADL2Call {
+public:
+    ADL2Call() { inADL2Call = true; }
+    ~ADL2Call() { inADL2Call = false; }
+};
+
+#define MOCK_EXPAND(...) __VA_ARGS__
+#define MOCK_ADL2(name, parameters, arguments) \
+    MOCK_EXPORT int ADL2_##name(ADL_CONTEXT_HANDLE context, MOCK_EXPAND parameters) { \
+        if(!enterContext(context)) { return ADL_ERR_NOT_INIT; } \
+        ADL2Call call; \
+        return ADL_##name arguments; \
+    }
+
+MOCK_EXPORT int ADL2_Main_Control_Create(ADL_MAIN_MALLOC_CALLBACK callback, int iEnumConnectedAdapters, ADL_CONTEXT_HANDLE *context) {
+    (void)iEnumConnectedAdapters;
+    std::lock_guard<std::mutex> lock(mutex);
+    if(!callback) { return ADL_ERR_INVALID_CALLBACK; }
+    if(!context) { return ADL_ERR_NULL_POINTER; }
+    if(creationFails()) { return ADL_ERR_NOT_SUPPORTED; }
+    if(!rig.initialized && rig.contexts.empty()) {
+        configure();
+    }
+    *context = (ADL_CONTEXT_HANDLE)(uintptr_t)++rig.lastContext;
+    rig.contexts.insert(*context);
+    return ADL_OK;
+}
+
+MOCK_EXPORT int ADL2_Main_Control_Destroy(ADL_CONTEXT_HANDLE context) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return rig.contexts.erase(context) > 0 ? ADL_OK : ADL_ERR_NOT_INIT;
+}
+
+MOCK_ADL2(Adapter_NumberOfAdapters_Get, (int *lpNumAdapters), (lpNumAdapters))
+MOCK_ADL2(Adapter_AdapterInfo_Get, (LPAdapterInfo lpInfo, int iInputSize), (lpInfo, iInputSize))
+MOCK_ADL2(Adapter_Active_Get, (int iAdapterIndex, int *lpStatus), (iAdapterIndex, lpStatus))
+MOCK_ADL2(Adapter_ID_Get, (int iAdapterIndex, int *lpAdapterID), (iAdapterIndex, lpAdapterID))
+MOCK_ADL2(Adapter_VideoBiosInfo_Get, (int iAdapterIndex, ADLBiosInfo *lpBiosInfo), (iAdapterIndex, lpBiosInfo))
+MOCK_ADL2(Overdrive_Caps, (int iAdapterIndex, int *iSupported, int *iEnabled, int *iVersion), (iAdapterIndex, iSupported, iEnabled, iVersion))
+MOCK_ADL2(Overdrive5_ThermalDevices_Enum, (int iAdapterIndex, int iThermalControllerIndex, ADLThermalControllerInfo *lpThermalControllerInfo), (iAdapterIndex, iThermalControllerIndex, lpThermalControllerInfo))
+MOCK_ADL2(Overdrive5_ODParameters_Get, (int iAdapterIndex, ADLODParameters *lpOdParameters), (iAdapterIndex, lpOdParameters))
+MOCK_ADL2(Overdrive5_Temperature_Get, (int iAdapterIndex, int iThermalControllerIndex, ADLTemperature *lpTemperature), (iAdapterIndex, iThermalControllerIndex, lpTemperature))
+MOCK_ADL2(Overdrive5_FanSpeed_Get, (int iAdapterIndex, int iThermalControllerIndex, ADLFanSpeedValue *lpFanSpeedValue), (iAdapterIndex, iThermalControllerIndex, lpFanSpeedValue))
+MOCK_ADL2(Overdrive5_FanSpeedInfo_Get, (int iAdapterIndex, int iThermalControllerIndex, ADLFanSpeedInfo *lpFanSpeedInfo), (iAdapterIndex, iThermalControllerIndex, lpFanSpeedInfo))
+MOCK_ADL2(Overdrive5_ODPerformanceLevels_Get, (int iAdapterIndex, int iDefault, ADLODPerformanceLevels *lpOdPerformanceLevels), (iAdapterIndex, iDefault, lpOdPerformanceLevels))
+MOCK_ADL2(Overdrive5_CurrentActivity_Get, (int iAdapterIndex, ADLPMActivity *lpActivity), (iAdapterIndex, lpActivity))
+MOCK_ADL2(Overdrive5_FanSpeed_Set, (int iAdapterIndex, int iThermalControllerIndex, ADLFanSpeedValue *lpFanSpeedValue), (iAdapterIndex, iThermalControllerIndex, lpFanSpeedValue))
+MOCK_ADL2(Overdrive5_FanSpeedToDefault_Set, (int iAdapterIndex, int iThermalControllerIndex), (iAdapterIndex, iThermalControllerIndex))
+MOCK_ADL2(Overdrive5_ODPerformanceLevels_Set, (int iAdapterIndex, ADLODPerformanceLevels *lpOdPerformanceLevels), (iAdapterIndex, lpOdPerformanceLevels))
+MOCK_ADL2(Overdrive5_PowerControl_Caps, (int iAdapterIndex, int *lpSupported), (iAdapterIndex, lpSupported))
+MOCK_ADL2(Overdrive5_PowerControlInfo_Get, (int iAdapterIndex, ADLPowerControlInfo *lpPowerControlInfo), (iAdapterIndex, lpPowerControlInfo))
+MOCK_ADL2(Overdrive5_PowerControl_Get, (int iAdapterIndex, int *lpCurrentValue, int *lpDefaultValue), (iAdapterIndex, lpCurrentValue, lpDefaultValue))
+MOCK_ADL2(Overdrive5_PowerControl_Set, (int iAdapterIndex, int iValue), (iAdapterIndex, iValue))
+MOCK_ADL2(Overdrive6_FanSpeed_Get, (int iAdapterIndex, ADLOD6FanSpeedInfo *lpFanSpeedInfo), (iAdapterIndex, lpFanSpeedInfo))
+MOCK_ADL2(Overdrive6_ThermalController_Caps, (int iAdapterIndex, ADLOD6ThermalControllerCaps *lpThermalControllerCaps), (iAdapterIndex, lpThermalControllerCaps))
+MOCK_ADL2(Overdrive6_Temperature_Get, (int iAdapterIndex, int *lpTemperature), (iAdapterIndex, lpTemperature))
+MOCK_ADL2(Overdrive6_Capabilities_Get, (int iAdapterIndex, ADLOD6Capabilities *lpODCapabilities), (iAdapterIndex, lpODCapabilities))
+MOCK_ADL2(Overdrive6_StateInfo_Get, (int iAdapterIndex, int iStateType, ADLOD6StateInfo *lpStateInfo), (iAdapterIndex, iStateType, lpStateInfo))
+MOCK_ADL2(Overdrive6_CurrentStatus_Get, (int iAdapterIndex, ADLOD6CurrentStatus *lpCurrentStatus), (iAdapterIndex, lpCurrentStatus))
+MOCK_ADL2(Overdrive6_PowerControl_Caps, (int iAdapterIndex, int *lpSupported), (iAdapterIndex, lpSupported))
+MOCK_ADL2(Overdrive6_PowerControlInfo_Get, (int iAdapterIndex, ADLOD6PowerControlInfo *lpPowerControlInfo), (iAdapterIndex, lpPowerControlInfo))
+MOCK_ADL2(Overdrive6_PowerControl_Get, (int iAdapterIndex, int *lpCurrentValue, int *lpDefaultValue), (iAdapterIndex, lpCurrentValue, lpDefaultValue))
+MOCK_ADL2(Overdrive6_FanSpeed_Set, (int iAdapterIndex, ADLOD6FanSpeedValue *lpFanSpeedValue), (iAdapterIndex, lpFanSpeedValue))
+MOCK_ADL2(Overdrive6_State_Set, (int iAdapterIndex, int iStateType, ADLOD6StateInfo *lpStateInfo), (iAdapterIndex, iStateType, lpStateInfo))
+MOCK_ADL2(Overdrive6_PowerControl_Set, (int iAdapterIndex, int iValue), (iAdapterIndex, iValue))
+
+// Instrumentation, not part of ADL.
+
+MOCK_EXPORT unsigned long long QtAMDMock_NumberOfCalls() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return rig.calls;
+}
+
+MOCK_EXPORT unsigned long long QtAMDMock_NumberOfLegacyCalls() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return rig.legacyCalls;
+}
+
+MOCK_EXPORT unsigned long long QtAMDMock_NumberOfInitializations() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return rig.initializations;
+}
+
+MOCK_EXPORT void QtAMDMock_ResetNumberOfCalls() {
+    std::lock_guard<std::mutex> lock(mutex);
+    rig.calls = 0;
+}
+
+// Replaces the functions QTAMD_MOCK_FAIL made fail, without creating the
+// context again.
+MOCK_EXPORT void QtAMDMock_SetFailingFunctions(const char *names) {
+    std::lock_guard<std::mutex> lock(mutex);
+    setFailing(names);
+}
+
+// Every entry point QtAMD resolves must exist here, with the right signature.
+#define QTAMD_MOCK_ENTRY_POINT(type, name) 1 + 0 * (int)sizeof(static_cast<type>(&::name)) +
+
+MOCK_EXPORT int QtAMDMock_NumberOfEntryPoints() {
+    return QTAMD_ADL_FUNCTIONS(QTAMD_MOCK_ENTRY_POINT) 0;
+}
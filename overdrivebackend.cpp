@@ -0,0 +1,651 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+//    This file is part of QtAMD.                                            //
+//    Copyright (C) 2015-2016 Jacob Dawid, jacob@omg-it.works                //
+//                                                                           //
+//    QtAMD is free software: you can redistribute it and/or modify          //
+//    it under the terms of the GNU Affero General Public License as         //
+//    published by the Free Software Foundation, either version 3 of the     //
+//    License, or (at your option) any later version.                        //
+//                                                                           //
+//    QtAMD is distributed in the hope that it will be useful,               //
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of         //
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          //
+//    GNU Affero General Public License for more details.                    //
+//                                                                           //
+//    You should have received a copy of the GNU General Public License      //
+//    along with QtAMD. If not, see <http://www.gnu.org/licenses/>.          //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "overdrivebackend.h"
+
+OverdriveBackend::OverdriveBackend(AMDOverdrive& overdrive)
+    : _overdrive(overdrive) {
+}
+
+OverdriveBackend::~OverdriveBackend() {
+}
+
+void OverdriveBackend::queryCapabilities(int adapterIndex, AMDOverdrive::AdapterCapabilities& caps) {
+    Q_UNUSED(adapterIndex);
+    caps.powerControlSupported = false;
+}
+
+void OverdriveBackend::queryThermalControllers(int adapterIndex, AMDOverdrive::AdapterCapabilities& caps) {
+    Q_UNUSED(adapterIndex);
+    Q_UNUSED(caps);
+}
+
+int OverdriveBackend::readActivity(int adapterIndex, ADLPMActivity *activity) {
+    Q_UNUSED(adapterIndex);
+    Q_UNUSED(activity);
+    return ADL_ERR_NOT_SUPPORTED;
+}
+
+int OverdriveBackend::readTemperature(int adapterIndex, int thermalControllerIndex, int *millidegreesCelsius) {
+    Q_UNUSED(adapterIndex);
+    Q_UNUSED(thermalControllerIndex);
+    Q_UNUSED(millidegreesCelsius);
+    return ADL_ERR_NOT_SUPPORTED;
+}
+
+int OverdriveBackend::readFanSpeed(int adapterIndex, int thermalControllerIndex, AMDOverdrive::FanSpeedValueType type, int *value) {
+    Q_UNUSED(adapterIndex);
+    Q_UNUSED(thermalControllerIndex);
+    Q_UNUSED(type);
+    Q_UNUSED(value);
+    return ADL_ERR_NOT_SUPPORTED;
+}
+
+void OverdriveBackend::sampleFanSpeeds(int adapterIndex, const AMDOverdrive::AdapterCapabilities& caps, AMDOverdrive::AdapterSample& sample) {
+    if(AMDOverdrive::canReadFanSpeed(caps, 0, AMDOverdrive::Rpm)
+    && readFanSpeed(adapterIndex, 0, AMDOverdrive::Rpm, &sample.fanSpeedRpm) == ADL_OK) {
+        sample.validFields |= AMDOverdrive::FanSpeedRpmField;
+    }
+    if(AMDOverdrive::canReadFanSpeed(caps, 0, AMDOverdrive::Percent)
+    && readFanSpeed(adapterIndex, 0, AMDOverdrive::Percent, &sample.fanSpeedPercent) == ADL_OK) {
+        sample.validFields |= AMDOverdrive::FanSpeedPercentField;
+    }
+}
+
+int OverdriveBackend::writeFanSpeed(int adapterIndex, int thermalControllerIndex, AMDOverdrive::FanSpeedValueType type, int value) {
+    Q_UNUSED(adapterIndex);
+    Q_UNUSED(thermalControllerIndex);
+    Q_UNUSED(type);
+    Q_UNUSED(value);
+    return ADL_ERR_NOT_SUPPORTED;
+}
+
+int OverdriveBackend::resetFanSpeed(int adapterIndex, int thermalControllerIndex) {
+    Q_UNUSED(adapterIndex);
+    Q_UNUSED(thermalControllerIndex);
+    return ADL_ERR_NOT_SUPPORTED;
+}
+
+int OverdriveBackend::readPowerControl(int adapterIndex, int *current, int *defaultValue) {
+    Q_UNUSED(adapterIndex);
+    Q_UNUSED(current);
+    Q_UNUSED(defaultValue);
+    return ADL_ERR_NOT_SUPPORTED;
+}
+
+int OverdriveBackend::writePowerControl(int adapterIndex, int value) {
+    Q_UNUSED(adapterIndex);
+    Q_UNUSED(value);
+    return ADL_ERR_NOT_SUPPORTED;
+}
+
+int OverdriveBackend::readPerformanceLevels(int adapterIndex, const AMDOverdrive::AdapterCapabilities& caps,
+                                            AMDOverdrive::PerformanceLevelInfo *levels, int capacity, int *count) {
+    Q_UNUSED(adapterIndex);
+    Q_UNUSED(caps);
+    Q_UNUSED(levels);
+    Q_UNUSED(capacity);
+    *count = 0;
+    return ADL_ERR_NOT_SUPPORTED;
+}
+
+int OverdriveBackend::writePerformanceLevels(int adapterIndex, const AMDOverdrive::AdapterCapabilities& caps,
+                                             AMDOverdrive::PerformanceLevelEdit *edits, int count) {
+    Q_UNUSED(adapterIndex);
+    validateEdits(caps, edits, count, 0);
+    return finishEdits(edits, count, ADL_ERR_NOT_SUPPORTED);
+}
+
+int OverdriveBackend::performanceLevelRange(const AMDOverdrive::AdapterCapabilities& caps, AMDOverdrive::PerformanceLevelField field,
+                                            AMDOverdrive::ValueRange *range) {
+    Q_UNUSED(caps);
+    Q_UNUSED(field);
+    Q_UNUSED(range);
+    return ADL_ERR_NOT_SUPPORTED;
+}
+
+AMDOverdrive::ValueRange OverdriveBackend::clockRange(int minimum, int maximum, int step) {
+    AMDOverdrive::ValueRange range;
+    // ADL reports 10 kHz units. Round inwards, so every value in the range
+    // is one the driver accepts.
+    range.minimum = (minimum + 99) / 100;
+    range.maximum = maximum / 100;
+    range.step = qMax(step / 100, 1);
+    return range;
+}
+
+int OverdriveBackend::validateEdits(const AMDOverdrive::AdapterCapabilities& caps, AMDOverdrive::PerformanceLevelEdit *edits, int count, int numberOfLevels) {
+    // Looked up once per field, not once per edit.
+    AMDOverdrive::ValueRange ranges[3];
+    int rangeReturnCodes[3];
+    for(int field = AMDOverdrive::CoreClock; field <= AMDOverdrive::Voltage; field++) {
+        memset(&ranges[field], 0, sizeof(AMDOverdrive::ValueRange));
+        rangeReturnCodes[field] = performanceLevelRange(caps, (AMDOverdrive::PerformanceLevelField)field, &ranges[field]);
+    }
+
+    int pending = 0;
+    for(int i = 0; i < count; i++) {
+        AMDOverdrive::PerformanceLevelEdit& edit = edits[i];
+        const AMDOverdrive::ValueRange& range = ranges[edit.field];
+        edit.allowedRange = range;
+
+        if(numberOfLevels <= 0) {
+            edit.returnCode = ADL_ERR_NOT_SUPPORTED;
+        } else if(edit.performanceLevel < 0 || edit.performanceLevel >= numberOfLevels) {
+            edit.returnCode = ADL_ERR_INVALID_PARAM;
+        } else if(rangeReturnCodes[edit.field] != ADL_OK) {
+            edit.returnCode = rangeReturnCodes[edit.field];
+        } else if(edit.value < range.minimum || edit.value > range.maximum) {
+            edit.returnCode = QTAMD_ERR_OUT_OF_RANGE;
+        } else {
+            // Round to the nearest step, without leaving the range.
+            int steps = (edit.value - range.minimum + range.step / 2) / range.step;
+            edit.value = qMin(range.minimum + steps * range.step, range.maximum);
+            edit.returnCode = ADL_OK;
+            pending++;
+        }
+    }
+    return pending;
+}
+
+int OverdriveBackend::finishEdits(AMDOverdrive::PerformanceLevelEdit *edits, int count, int returnCode) {
+    int firstError = ADL_OK;
+    for(int i = 0; i < count; i++) {
+        if(edits[i].returnCode == ADL_OK) {
+            edits[i].returnCode = returnCode;
+        }
+        if(firstError == ADL_OK) {
+            firstError = edits[i].returnCode;
+        }
+    }
+    return firstError;
+}
+
+UnsupportedOverdriveBackend::UnsupportedOverdriveBackend(AMDOverdrive& overdrive)
+    : OverdriveBackend(overdrive) {
+}
+
+int UnsupportedOverdriveBackend::version() const {
+    return 0;
+}
+
+Overdrive5Backend::Overdrive5Backend(AMDOverdrive& overdrive, const ADLFunctionTable& adl)
+    : OverdriveBackend(overdrive),
+      _thermalDevicesEnum(adl.ADL_Overdrive5_ThermalDevices_Enum),
+      _fanSpeedInfoGet(adl.ADL_Overdrive5_FanSpeedInfo_Get),
+      _currentActivityGet(adl.ADL_Overdrive5_CurrentActivity_Get),
+      _temperatureGet(adl.ADL_Overdrive5_Temperature_Get),
+      _fanSpeedGet(adl.ADL_Overdrive5_FanSpeed_Get),
+      _fanSpeedSet(adl.ADL_Overdrive5_FanSpeed_Set),
+      _fanSpeedToDefaultSet(adl.ADL_Overdrive5_FanSpeedToDefault_Set),
+      _powerControlCaps(adl.ADL_Overdrive5_PowerControl_Caps),
+      _powerControlInfoGet(adl.ADL_Overdrive5_PowerControlInfo_Get),
+      _powerControlGet(adl.ADL_Overdrive5_PowerControl_Get),
+      _powerControlSet(adl.ADL_Overdrive5_PowerControl_Set),
+      _performanceLevelsGet(adl.ADL_Overdrive5_ODPerformanceLevels_Get),
+      _performanceLevelsSet(adl.ADL_Overdrive5_ODPerformanceLevels_Set) {
+}
+
+int Overdrive5Backend::version() const {
+    return 5;
+}
+
+void Overdrive5Backend::queryCapabilities(int adapterIndex, AMDOverdrive::AdapterCapabilities& caps) {
+    caps.overdriveParameters = _overdrive.overdriveParameters(adapterIndex).value();
+
+    int isSupported = 0;
+    if(_overdrive.callAdapter(ADLFunction::ADL_Overdrive5_PowerControl_Caps, _powerControlCaps, adapterIndex, &isSupported) != ADL_OK) {
+        isSupported = 0;
+    }
+    if(isSupported) {
+        _overdrive.callAdapter(ADLFunction::ADL_Overdrive5_PowerControlInfo_Get, _powerControlInfoGet, adapterIndex, &caps.powerControlInfo);
+    }
+    caps.powerControlSupported = (bool)isSupported;
+}
+
+void Overdrive5Backend::queryThermalControllers(int adapterIndex, AMDOverdrive::AdapterCapabilities& caps) {
+    if(!_overdrive.isFunctionAvailable(ADLFunction::ADL_Overdrive5_ThermalDevices_Enum)) {
+        caps.thermalControllersReturnCode = _overdrive.reportFailure(ADLFunction::ADL_Overdrive5_ThermalDevices_Enum, QTAMD_ERR_FUNCTION_NOT_AVAILABLE);
+        return;
+    }
+
+    int returnCode = ADL_OK;
+    for(int i = 0; i < AMDOverdrive::MaxThermalControllers; i++) {
+        ADLThermalControllerInfo thermalControllerInfo = {0, 0, 0, 0};
+        thermalControllerInfo.iSize = sizeof(ADLThermalControllerInfo);
+        // Past the last controller the driver warns that there's no data.
+        int probeReturnCode = _overdrive.callAdapter(ADLFunction::ADL_Overdrive5_ThermalDevices_Enum, _thermalDevicesEnum, adapterIndex, i, &thermalControllerInfo);
+        if(probeReturnCode == ADL_WARNING_NO_DATA) {
+            break;
+        }
+        if(probeReturnCode != ADL_OK) {
+            returnCode = probeReturnCode;
+            continue;
+        }
+        caps.thermalControllers[caps.numberOfThermalControllers++] = thermalControllerInfo;
+
+        ADLFanSpeedInfo& fanSpeedInfo = caps.fanSpeedInfo[i];
+        fanSpeedInfo.iSize = sizeof(ADLFanSpeedInfo);
+        caps.fanSpeedInfoReturnCodes[i] = _overdrive.callAdapter(ADLFunction::ADL_Overdrive5_FanSpeedInfo_Get, _fanSpeedInfoGet, adapterIndex, i, &fanSpeedInfo);
+    }
+
+    // Only a failure if no thermal controller could be enumerated.
+    caps.thermalControllersReturnCode = caps.numberOfThermalControllers > 0 ? ADL_OK : returnCode;
+}
+
+int Overdrive5Backend::readActivity(int adapterIndex, ADLPMActivity *activity) {
+    return _overdrive.callAdapter(ADLFunction::ADL_Overdrive5_CurrentActivity_Get, _currentActivityGet, adapterIndex, activity);
+}
+
+int Overdrive5Backend::readTemperature(int adapterIndex, int thermalControllerIndex, int *millidegreesCelsius) {
+    ADLTemperature temperature = {0, 0};
+    temperature.iSize = sizeof(ADLTemperature);
+
+    int returnCode = _overdrive.callAdapter(ADLFunction::ADL_Overdrive5_Temperature_Get, _temperatureGet, adapterIndex, thermalControllerIndex, &temperature);
+    if(returnCode == ADL_OK) {
+        *millidegreesCelsius = temperature.iTemperature;
+    }
+    return returnCode;
+}
+
+int Overdrive5Backend::readFanSpeed(int adapterIndex, int thermalControllerIndex, AMDOverdrive::FanSpeedValueType type, int *value) {
+    ADLFanSpeedValue fanSpeedValue = {0, 0, 0, 0};
+    fanSpeedValue.iSize = sizeof(ADLFanSpeedValue);
+    fanSpeedValue.iSpeedType = (type == AMDOverdrive::Rpm) ? ADL_DL_FANCTRL_SPEED_TYPE_RPM : ADL_DL_FANCTRL_SPEED_TYPE_PERCENT;
+
+    int returnCode = _overdrive.callAdapter(ADLFunction::ADL_Overdrive5_FanSpeed_Get, _fanSpeedGet, adapterIndex, thermalControllerIndex, &fanSpeedValue);
+    if(returnCode == ADL_OK) {
+        *value = fanSpeedValue.iFanSpeed;
+    }
+    return returnCode;
+}
+
+int Overdrive5Backend::writeFanSpeed(int adapterIndex, int thermalControllerIndex, AMDOverdrive::FanSpeedValueType type, int value) {
+    ADLFanSpeedValue fanSpeedValue = {0, 0, 0, 0};
+    fanSpeedValue.iSize = sizeof(ADLFanSpeedValue);
+    fanSpeedValue.iSpeedType = (type == AMDOverdrive::Rpm) ? ADL_DL_FANCTRL_SPEED_TYPE_RPM : ADL_DL_FANCTRL_SPEED_TYPE_PERCENT;
+    fanSpeedValue.iFanSpeed = value;
+
+    return _overdrive.callAdapter(ADLFunction::ADL_Overdrive5_FanSpeed_Set, _fanSpeedSet, adapterIndex, thermalControllerIndex, &fanSpeedValue);
+}
+
+int Overdrive5Backend::resetFanSpeed(int adapterIndex, int thermalControllerIndex) {
+    return _overdrive.callAdapter(ADLFunction::ADL_Overdrive5_FanSpeedToDefault_Set, _fanSpeedToDefaultSet, adapterIndex, thermalControllerIndex);
+}
+
+int Overdrive5Backend::readPowerControl(int adapterIndex, int *current, int *defaultValue) {
+    return _overdrive.callAdapter(ADLFunction::ADL_Overdrive5_PowerControl_Get, _powerControlGet, adapterIndex, current, defaultValue);
+}
+
+int Overdrive5Backend::writePowerControl(int adapterIndex, int value) {
+    return _overdrive.callAdapter(ADLFunction::ADL_Overdrive5_PowerControl_Set, _powerControlSet, adapterIndex, value);
+}
+
+int Overdrive5Backend::readPerformanceLevels(int adapterIndex, const AMDOverdrive::AdapterCapabilities& caps,
+                                             AMDOverdrive::PerformanceLevelInfo *levels, int capacity, int *count) {
+    *count = 0;
+
+    int n = caps.overdriveParameters.iNumberOfPerformanceLevels;
+    if(n <= 0) { return ADL_ERR_NOT_SUPPORTED; }
+    if(n > capacity) {
+        *count = n;
+        return ADL_ERR_INVALID_PARAM_SIZE;
+    }
+
+    // Up to MaxPerformanceLevels levels the buffers live on the stack.
+    LevelsBuffer<ADLODPerformanceLevels, ADLODPerformanceLevel> defaultLevels(n), currentLevels(n);
+    if(!defaultLevels.levels() || !currentLevels.levels()) {
+        return ADL_ERR;
+    }
+    defaultLevels.levels()->iSize = defaultLevels.size();
+    currentLevels.levels()->iSize = currentLevels.size();
+
+    int returnCode = _overdrive.callAdapter(ADLFunction::ADL_Overdrive5_ODPerformanceLevels_Get, _performanceLevelsGet, adapterIndex, 0, currentLevels.levels());
+    if(returnCode == ADL_OK) {
+        returnCode = _overdrive.callAdapter(ADLFunction::ADL_Overdrive5_ODPerformanceLevels_Get, _performanceLevelsGet, adapterIndex, 1, defaultLevels.levels());
+    }
+    if(returnCode != ADL_OK) {
+        return returnCode;
+    }
+
+    for(int i = 0; i < n; i++) {
+        levels[i].stock = defaultLevels.levels()->aLevels[i];
+        levels[i].current = currentLevels.levels()->aLevels[i];
+    }
+    *count = n;
+    return ADL_OK;
+}
+
+int Overdrive5Backend::writePerformanceLevels(int adapterIndex, const AMDOverdrive::AdapterCapabilities& caps,
+                                              AMDOverdrive::PerformanceLevelEdit *edits, int count) {
+    int n = caps.overdriveParameters.iNumberOfPerformanceLevels;
+    if(validateEdits(caps, edits, count, n) == 0) {
+        return finishEdits(edits, count, ADL_OK);
+    }
+
+    LevelsBuffer<ADLODPerformanceLevels, ADLODPerformanceLevel> currentLevels(n);
+    if(!currentLevels.levels()) {
+        return finishEdits(edits, count, ADL_ERR);
+    }
+    currentLevels.levels()->iSize = currentLevels.size();
+
+    int returnCode = _overdrive.callAdapter(ADLFunction::ADL_Overdrive5_ODPerformanceLevels_Get, _performanceLevelsGet, adapterIndex, 0, currentLevels.levels());
+    if(returnCode == ADL_OK) {
+        for(int i = 0; i < count; i++) {
+            const AMDOverdrive::PerformanceLevelEdit& edit = edits[i];
+            if(edit.returnCode != ADL_OK) {
+                continue;
+            }
+            ADLODPerformanceLevel& level = currentLevels.levels()->aLevels[edit.performanceLevel];
+            switch (edit.field) {
+            case AMDOverdrive::CoreClock:
+                level.iEngineClock = edit.value * 100;
+                break;
+            case AMDOverdrive::MemoryClock:
+                level.iMemoryClock = edit.value * 100;
+                break;
+            case AMDOverdrive::Voltage:
+                level.iVddc = edit.value;
+                break;
+            }
+        }
+        returnCode = _overdrive.callAdapter(ADLFunction::ADL_Overdrive5_ODPerformanceLevels_Set, _performanceLevelsSet, adapterIndex, currentLevels.levels());
+    }
+
+    return finishEdits(edits, count, returnCode);
+}
+
+int Overdrive5Backend::performanceLevelRange(const AMDOverdrive::AdapterCapabilities& caps, AMDOverdrive::PerformanceLevelField field,
+                                             AMDOverdrive::ValueRange *range) {
+    const ADLODParameters& parameters = caps.overdriveParameters;
+    if(parameters.iNumberOfPerformanceLevels <= 0) {
+        return ADL_ERR_NOT_SUPPORTED;
+    }
+
+    switch (field) {
+    case AMDOverdrive::CoreClock:
+        *range = clockRange(parameters.sEngineClock.iMin, parameters.sEngineClock.iMax, parameters.sEngineClock.iStep);
+        break;
+    case AMDOverdrive::MemoryClock:
+        *range = clockRange(parameters.sMemoryClock.iMin, parameters.sMemoryClock.iMax, parameters.sMemoryClock.iStep);
+        break;
+    case AMDOverdrive::Voltage:
+        range->minimum = parameters.sVddc.iMin;
+        range->maximum = parameters.sVddc.iMax;
+        range->step = qMax(parameters.sVddc.iStep, 1);
+        break;
+    }
+    return ADL_OK;
+}
+
+Overdrive6Backend::Overdrive6Backend(AMDOverdrive& overdrive, const ADLFunctionTable& adl)
+    : OverdriveBackend(overdrive),
+      _currentStatusGet(adl.ADL_Overdrive6_CurrentStatus_Get),
+      _temperatureGet(adl.ADL_Overdrive6_Temperature_Get),
+      _fanSpeedGet(adl.ADL_Overdrive6_FanSpeed_Get),
+      _fanSpeedSet(adl.ADL_Overdrive6_FanSpeed_Set),
+      _powerControlCaps(adl.ADL_Overdrive6_PowerControl_Caps),
+      _powerControlInfoGet(adl.ADL_Overdrive6_PowerControlInfo_Get),
+      _powerControlGet(adl.ADL_Overdrive6_PowerControl_Get),
+      _powerControlSet(adl.ADL_Overdrive6_PowerControl_Set),
+      _capabilitiesGet(adl.ADL_Overdrive6_Capabilities_Get),
+      _stateInfoGet(adl.ADL_Overdrive6_StateInfo_Get),
+      _stateSet(adl.ADL_Overdrive6_State_Set),
+      _thermalControllerCaps(adl.ADL_Overdrive6_ThermalController_Caps) {
+}
+
+int Overdrive6Backend::version() const {
+    return 6;
+}
+
+void Overdrive6Backend::queryCapabilities(int adapterIndex, AMDOverdrive::AdapterCapabilities& caps) {
+    _overdrive.callAdapter(ADLFunction::ADL_Overdrive6_Capabilities_Get, _capabilitiesGet, adapterIndex, &caps.overdrive6Capabilities);
+
+    int isSupported = 0;
+    if(_overdrive.callAdapter(ADLFunction::ADL_Overdrive6_PowerControl_Caps, _powerControlCaps, adapterIndex, &isSupported) != ADL_OK) {
+        isSupported = 0;
+    }
+    if(isSupported) {
+        ADLOD6PowerControlInfo info6 = {0, 0, 0, 0, 0};
+        if(_overdrive.callAdapter(ADLFunction::ADL_Overdrive6_PowerControlInfo_Get, _powerControlInfoGet, adapterIndex, &info6) == ADL_OK) {
+            caps.powerControlInfo.iMinValue = info6.iMinValue;
+            caps.powerControlInfo.iMaxValue = info6.iMaxValue;
+            caps.powerControlInfo.iStepValue = info6.iStepValue;
+        }
+    }
+    caps.powerControlSupported = (bool)isSupported;
+}
+
+void Overdrive6Backend::queryThermalControllers(int adapterIndex, AMDOverdrive::AdapterCapabilities& caps) {
+    // Overdrive 6 only knows the GPU's own thermal controller. Its caps are
+    // translated into the Overdrive 5 structures.
+    ADLOD6ThermalControllerCaps thermalControllerCaps;
+    memset(&thermalControllerCaps, 0, sizeof(ADLOD6ThermalControllerCaps));
+    int returnCode = _overdrive.callAdapter(ADLFunction::ADL_Overdrive6_ThermalController_Caps, _thermalControllerCaps, adapterIndex, &thermalControllerCaps);
+    if(returnCode == ADL_OK && !(thermalControllerCaps.iCapabilities & ADL_OD6_TCCAPS_THERMAL_CONTROLLER)) {
+        returnCode = ADL_ERR_NOT_SUPPORTED;
+    }
+    caps.thermalControllersReturnCode = returnCode;
+    if(returnCode != ADL_OK) {
+        return;
+    }
+
+    ADLThermalControllerInfo& thermalControllerInfo = caps.thermalControllers[0];
+    thermalControllerInfo.iSize = sizeof(ADLThermalControllerInfo);
+    thermalControllerInfo.iThermalDomain = ADL_DL_THERMAL_DOMAIN_GPU;
+    thermalControllerInfo.iDomainIndex = 0;
+    caps.numberOfThermalControllers = 1;
+
+    if(!(thermalControllerCaps.iCapabilities & ADL_OD6_TCCAPS_FANSPEED_CONTROL)) {
+        return;
+    }
+
+    ADLFanSpeedInfo& fanSpeedInfo = caps.fanSpeedInfo[0];
+    fanSpeedInfo.iSize = sizeof(ADLFanSpeedInfo);
+    if(thermalControllerCaps.iCapabilities & ADL_OD6_TCCAPS_FANSPEED_PERCENT_READ) {
+        fanSpeedInfo.iFlags |= ADL_DL_FANCTRL_SUPPORTS_PERCENT_READ;
+    }
+    if(thermalControllerCaps.iCapabilities & ADL_OD6_TCCAPS_FANSPEED_PERCENT_WRITE) {
+        fanSpeedInfo.iFlags |= ADL_DL_FANCTRL_SUPPORTS_PERCENT_WRITE;
+    }
+    if(thermalControllerCaps.iCapabilities & ADL_OD6_TCCAPS_FANSPEED_RPM_READ) {
+        fanSpeedInfo.iFlags |= ADL_DL_FANCTRL_SUPPORTS_RPM_READ;
+    }
+    if(thermalControllerCaps.iCapabilities & ADL_OD6_TCCAPS_FANSPEED_RPM_WRITE) {
+        fanSpeedInfo.iFlags |= ADL_DL_FANCTRL_SUPPORTS_RPM_WRITE;
+    }
+    fanSpeedInfo.iMinPercent = thermalControllerCaps.iFanMinPercent;
+    fanSpeedInfo.iMaxPercent = thermalControllerCaps.iFanMaxPercent;
+    fanSpeedInfo.iMinRPM = thermalControllerCaps.iFanMinRPM;
+    fanSpeedInfo.iMaxRPM = thermalControllerCaps.iFanMaxRPM;
+    caps.fanSpeedInfoReturnCodes[0] = ADL_OK;
+}
+
+int Overdrive6Backend::readActivity(int adapterIndex, ADLPMActivity *activity) {
+    ADLOD6CurrentStatus status;
+    memset(&status, 0, sizeof(ADLOD6CurrentStatus));
+
+    int returnCode = _overdrive.callAdapter(ADLFunction::ADL_Overdrive6_CurrentStatus_Get, _currentStatusGet, adapterIndex, &status);
+    if(returnCode == ADL_OK) {
+        // Same units as Overdrive 5, but there's no voltage.
+        activity->iEngineClock = status.iEngineClock;
+        activity->iMemoryClock = status.iMemoryClock;
+        activity->iActivityPercent = status.iActivityPercent;
+        activity->iCurrentPerformanceLevel = status.iCurrentPerformanceLevel;
+        activity->iCurrentBusSpeed = status.iCurrentBusSpeed;
+        activity->iCurrentBusLanes = status.iCurrentBusLanes;
+        activity->iMaximumBusLanes = status.iMaximumBusLanes;
+    }
+    return returnCode;
+}
+
+int Overdrive6Backend::readTemperature(int adapterIndex, int thermalControllerIndex, int *millidegreesCelsius) {
+    // Overdrive 6 only knows the GPU's own thermal controller.
+    if(thermalControllerIndex != 0) {
+        return ADL_ERR_INVALID_CONTROLLER_IDX;
+    }
+    return _overdrive.callAdapter(ADLFunction::ADL_Overdrive6_Temperature_Get, _temperatureGet, adapterIndex, millidegreesCelsius);
+}
+
+int Overdrive6Backend::readFanSpeed(int adapterIndex, int thermalControllerIndex, AMDOverdrive::FanSpeedValueType type, int *value) {
+    if(thermalControllerIndex != 0) {
+        return ADL_ERR_INVALID_CONTROLLER_IDX;
+    }
+
+    ADLOD6FanSpeedInfo fanSpeedInfo;
+    int returnCode = readFanSpeedInfo(adapterIndex, &fanSpeedInfo);
+    if(returnCode != ADL_OK) {
+        return returnCode;
+    }
+    if(!(fanSpeedInfo.iSpeedType & ((type == AMDOverdrive::Rpm) ? ADL_OD6_FANSPEED_TYPE_RPM : ADL_OD6_FANSPEED_TYPE_PERCENT))) {
+        return ADL_ERR_NOT_SUPPORTED;
+    }
+    *value = (type == AMDOverdrive::Rpm) ? fanSpeedInfo.iFanSpeedRPM : fanSpeedInfo.iFanSpeedPercent;
+    return ADL_OK;
+}
+
+void Overdrive6Backend::sampleFanSpeeds(int adapterIndex, const AMDOverdrive::AdapterCapabilities& caps, AMDOverdrive::AdapterSample& sample) {
+    Q_UNUSED(caps);
+    // Both fan speeds are returned by a single call.
+    ADLOD6FanSpeedInfo fanSpeedInfo;
+    if(readFanSpeedInfo(adapterIndex, &fanSpeedInfo) != ADL_OK) {
+        return;
+    }
+    if(fanSpeedInfo.iSpeedType & ADL_OD6_FANSPEED_TYPE_RPM) {
+        sample.fanSpeedRpm = fanSpeedInfo.iFanSpeedRPM;
+        sample.validFields |= AMDOverdrive::FanSpeedRpmField;
+    }
+    if(fanSpeedInfo.iSpeedType & ADL_OD6_FANSPEED_TYPE_PERCENT) {
+        sample.fanSpeedPercent = fanSpeedInfo.iFanSpeedPercent;
+        sample.validFields |= AMDOverdrive::FanSpeedPercentField;
+    }
+}
+
+int Overdrive6Backend::writeFanSpeed(int adapterIndex, int thermalControllerIndex, AMDOverdrive::FanSpeedValueType type, int value) {
+    if(thermalControllerIndex != 0) {
+        return ADL_ERR_INVALID_CONTROLLER_IDX;
+    }
+
+    ADLOD6FanSpeedValue fanSpeedValue = {0, 0, 0, 0};
+    fanSpeedValue.iSpeedType = (type == AMDOverdrive::Rpm) ? ADL_OD6_FANSPEED_TYPE_RPM : ADL_OD6_FANSPEED_TYPE_PERCENT;
+    fanSpeedValue.iFanSpeed = value;
+
+    return _overdrive.callAdapter(ADLFunction::ADL_Overdrive6_FanSpeed_Set, _fanSpeedSet, adapterIndex, &fanSpeedValue);
+}
+
+int Overdrive6Backend::readPowerControl(int adapterIndex, int *current, int *defaultValue) {
+    return _overdrive.callAdapter(ADLFunction::ADL_Overdrive6_PowerControl_Get, _powerControlGet, adapterIndex, current, defaultValue);
+}
+
+int Overdrive6Backend::writePowerControl(int adapterIndex, int value) {
+    return _overdrive.callAdapter(ADLFunction::ADL_Overdrive6_PowerControl_Set, _powerControlSet, adapterIndex, value);
+}
+
+int Overdrive6Backend::readPerformanceLevels(int adapterIndex, const AMDOverdrive::AdapterCapabilities& caps,
+                                             AMDOverdrive::PerformanceLevelInfo *levels, int capacity, int *count) {
+    *count = 0;
+
+    int n = caps.overdrive6Capabilities.iNumberOfPerformanceLevels;
+    if(n <= 0) { return ADL_ERR_NOT_SUPPORTED; }
+    if(n > capacity) {
+        *count = n;
+        return ADL_ERR_INVALID_PARAM_SIZE;
+    }
+
+    LevelsBuffer<ADLOD6StateInfo, ADLOD6PerformanceLevel> defaultState(n), currentState(n);
+    if(!defaultState.levels() || !currentState.levels()) {
+        return ADL_ERR;
+    }
+    defaultState.levels()->iNumberOfPerformanceLevels = n;
+    currentState.levels()->iNumberOfPerformanceLevels = n;
+
+    int returnCode = _overdrive.callAdapter(ADLFunction::ADL_Overdrive6_StateInfo_Get, _stateInfoGet, adapterIndex, ADL_OD6_GETSTATEINFO_CUSTOM_PERFORMANCE, currentState.levels());
+    if(returnCode == ADL_OK) {
+        returnCode = _overdrive.callAdapter(ADLFunction::ADL_Overdrive6_StateInfo_Get, _stateInfoGet, adapterIndex, ADL_OD6_GETSTATEINFO_DEFAULT_PERFORMANCE, defaultState.levels());
+    }
+    if(returnCode != ADL_OK) {
+        return returnCode;
+    }
+
+    // Overdrive 6 levels have no voltage.
+    for(int i = 0; i < n; i++) {
+        levels[i].stock.iEngineClock = defaultState.levels()->aLevels[i].iEngineClock;
+        levels[i].stock.iMemoryClock = defaultState.levels()->aLevels[i].iMemoryClock;
+        levels[i].stock.iVddc = 0;
+        levels[i].current.iEngineClock = currentState.levels()->aLevels[i].iEngineClock;
+        levels[i].current.iMemoryClock = currentState.levels()->aLevels[i].iMemoryClock;
+        levels[i].current.iVddc = 0;
+    }
+    *count = n;
+    return ADL_OK;
+}
+
+int Overdrive6Backend::writePerformanceLevels(int adapterIndex, const AMDOverdrive::AdapterCapabilities& caps,
+                                              AMDOverdrive::PerformanceLevelEdit *edits, int count) {
+    int n = caps.overdrive6Capabilities.iNumberOfPerformanceLevels;
+    if(validateEdits(caps, edits, count, n) == 0) {
+        return finishEdits(edits, count, ADL_OK);
+    }
+
+    LevelsBuffer<ADLOD6StateInfo, ADLOD6PerformanceLevel> state(n);
+    if(!state.levels()) {
+        return finishEdits(edits, count, ADL_ERR);
+    }
+    state.levels()->iNumberOfPerformanceLevels = n;
+
+    int returnCode = _overdrive.callAdapter(ADLFunction::ADL_Overdrive6_StateInfo_Get, _stateInfoGet, adapterIndex, ADL_OD6_GETSTATEINFO_CUSTOM_PERFORMANCE, state.levels());
+    if(returnCode == ADL_OK) {
+        for(int i = 0; i < count; i++) {
+            const AMDOverdrive::PerformanceLevelEdit& edit = edits[i];
+            if(edit.returnCode != ADL_OK) {
+                continue;
+            }
+            ADLOD6PerformanceLevel& level = state.levels()->aLevels[edit.performanceLevel];
+            if(edit.field == AMDOverdrive::CoreClock) {
+                level.iEngineClock = edit.value * 100;
+            } else {
+                level.iMemoryClock = edit.value * 100;
+            }
+        }
+        returnCode = _overdrive.callAdapter(ADLFunction::ADL_Overdrive6_State_Set, _stateSet, adapterIndex, ADL_OD6_SETSTATE_PERFORMANCE, state.levels());
+    }
+
+    return finishEdits(edits, count, returnCode);
+}
+
+int Overdrive6Backend::performanceLevelRange(const AMDOverdrive::AdapterCapabilities& caps, AMDOverdrive::PerformanceLevelField field,
+                                             AMDOverdrive::ValueRange *range) {
+    // Overdrive 6 performance levels only have clocks.
+    const ADLOD6Capabilities& capabilities = caps.overdrive6Capabilities;
+    if(field == AMDOverdrive::CoreClock && (capabilities.iCapabilities & ADL_OD6_CAPABILITY_SCLK_CUSTOMIZATION)) {
+        *range = clockRange(capabilities.sEngineClockRange.iMin, capabilities.sEngineClockRange.iMax, capabilities.sEngineClockRange.iStep);
+        return ADL_OK;
+    }
+    if(field == AMDOverdrive::MemoryClock && (capabilities.iCapabilities & ADL_OD6_CAPABILITY_MCLK_CUSTOMIZATION)) {
+        *range = clockRange(capabilities.sMemoryClockRange.iMin, capabilities.sMemoryClockRange.iMax, capabilities.sMemoryClockRange.iStep);
+        return ADL_OK;
+    }
+    return ADL_ERR_NOT_SUPPORTED;
+}
+
+int Overdrive6Backend::readFanSpeedInfo(int adapterIndex, ADLOD6FanSpeedInfo *fanSpeedInfo) {
+    memset(fanSpeedInfo, 0, sizeof(ADLOD6FanSpeedInfo));
+    return _overdrive.callAdapter(ADLFunction::ADL_Overdrive6_FanSpeed_Get, _fanSpeedGet, adapterIndex, fanSpeedInfo);
+}
@@ -0,0 +1,212 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+//    This file is part of QtAMD.                                            //
+//    Copyright (C) 2015-2016 Jacob Dawid, jacob@omg-it.works                //
+//                                                                           //
+//    QtAMD is free software: you can redistribute it and/or modify          //
+//    it under the terms of the GNU Affero General Public License as         //
+//    published by the Free Software Foundation, either version 3 of the     //
+//    License, or (at your option) any later version.                        //
+//                                                                           //
+//    QtAMD is distributed in the hope that it will be useful,               //
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of         //
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          //
+//    GNU Affero General Public License for more details.                    //
+//                                                                           //
+//    You should have received a copy of the GNU General Public License      //
+//    along with QtAMD. If not, see <http://www.gnu.org/licenses/>.          //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "amdoverdrive.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Implements the Overdrive generation specific calls of AMDOverdrive. One
+ * backend per generation is created when the library is loaded, with its
+ * entry points bound once, and every adapter is assigned a backend when
+ * its capabilities are queried. Calls a generation doesn't have return
+ * ADL_ERR_NOT_SUPPORTED.
+ */
+class OverdriveBackend {
+public:
+    OverdriveBackend(AMDOverdrive& overdrive);
+    virtual ~OverdriveBackend();
+
+    // Overdrive version implemented by this backend, 0 if unsupported.
+    virtual int version() const = 0;
+
+    // Fills in the version specific parts of caps.
+    virtual void queryCapabilities(int adapterIndex, AMDOverdrive::AdapterCapabilities& caps);
+    // Enumerates the thermal controllers and their fans into caps.
+    virtual void queryThermalControllers(int adapterIndex, AMDOverdrive::AdapterCapabilities& caps);
+
+    virtual int readActivity(int adapterIndex, ADLPMActivity *activity);
+    virtual int readTemperature(int adapterIndex, int thermalControllerIndex, int *millidegreesCelsius);
+    virtual int readFanSpeed(int adapterIndex, int thermalControllerIndex, AMDOverdrive::FanSpeedValueType type, int *value);
+    // Reads both fan speeds of the GPU's own thermal controller into sample.
+    virtual void sampleFanSpeeds(int adapterIndex, const AMDOverdrive::AdapterCapabilities& caps, AMDOverdrive::AdapterSample& sample);
+    virtual int writeFanSpeed(int adapterIndex, int thermalControllerIndex, AMDOverdrive::FanSpeedValueType type, int value);
+    virtual int resetFanSpeed(int adapterIndex, int thermalControllerIndex);
+    virtual int readPowerControl(int adapterIndex, int *current, int *defaultValue);
+    virtual int writePowerControl(int adapterIndex, int value);
+    // Fails with ADL_ERR_INVALID_PARAM_SIZE and sets count to the number of
+    // levels if they don't fit into capacity.
+    virtual int readPerformanceLevels(int adapterIndex, const AMDOverdrive::AdapterCapabilities& caps,
+                                      AMDOverdrive::PerformanceLevelInfo *levels, int capacity, int *count);
+    // Applies all edits with a single read and a single write, and sets the
+    // result of every edit.
+    virtual int writePerformanceLevels(int adapterIndex, const AMDOverdrive::AdapterCapabilities& caps,
+                                       AMDOverdrive::PerformanceLevelEdit *edits, int count);
+    // Range of a performance level field, from the cached capabilities.
+    virtual int performanceLevelRange(const AMDOverdrive::AdapterCapabilities& caps, AMDOverdrive::PerformanceLevelField field,
+                                      AMDOverdrive::ValueRange *range);
+
+protected:
+    // An ADL struct ending in a variable number of levels, e.g.
+    // ADLODPerformanceLevels, sized for numberOfLevels levels. Up to
+    // MaxPerformanceLevels levels live in the object itself, so the common
+    // case doesn't allocate, more are allocated on the heap.
+    template<typename Levels, typename Level>
+    class LevelsBuffer {
+    public:
+        LevelsBuffer(int numberOfLevels)
+            : _size(sizeof(Levels) + sizeof(Level) * (qMax(numberOfLevels, 1) - 1)),
+              _heap(0),
+              _levels(&_inline.levels) {
+            if(numberOfLevels > AMDOverdrive::MaxPerformanceLevels) {
+                _heap = (Levels*)malloc(_size);
+                _levels = _heap;
+            }
+            if(_levels) {
+                memset(_levels, 0, _size);
+            }
+        }
+        ~LevelsBuffer() {
+            free(_heap);
+        }
+
+        // 0 if the heap allocation failed.
+        Levels *levels() {
+            return _levels;
+        }
+        int size() const {
+            return _size;
+        }
+
+    private:
+        struct Inline {
+            Levels levels;
+            Level moreLevels[AMDOverdrive::MaxPerformanceLevels - 1];
+        };
+
+        Inline _inline;
+        int _size;
+        Levels *_heap;
+        Levels *_levels;
+
+        Q_DISABLE_COPY(LevelsBuffer)
+    };
+
+    // Converts a range in ADL's 10 kHz units to MHz.
+    static AMDOverdrive::ValueRange clockRange(int minimum, int maximum, int step);
+
+    // Rejects edits of levels or fields that don't exist and values out of
+    // range, snaps the others to the step and marks them as pending.
+    // Returns the number of pending edits. Nothing is sent to the driver.
+    int validateEdits(const AMDOverdrive::AdapterCapabilities& caps, AMDOverdrive::PerformanceLevelEdit *edits, int count, int numberOfLevels);
+    // Sets the result of all pending edits. Returns ADL_OK if all edits
+    // have been applied, the first edit's error otherwise.
+    static int finishEdits(AMDOverdrive::PerformanceLevelEdit *edits, int count, int returnCode);
+
+    AMDOverdrive& _overdrive;
+};
+
+/** Backend for adapters without a supported Overdrive version. */
+class UnsupportedOverdriveBackend : public OverdriveBackend {
+public:
+    UnsupportedOverdriveBackend(AMDOverdrive& overdrive);
+
+    int version() const;
+};
+
+/** Overdrive 5, using ADL_Overdrive5_*. */
+class Overdrive5Backend : public OverdriveBackend {
+public:
+    Overdrive5Backend(AMDOverdrive& overdrive, const ADLFunctionTable& adl);
+
+    int version() const;
+    void queryCapabilities(int adapterIndex, AMDOverdrive::AdapterCapabilities& caps);
+    void queryThermalControllers(int adapterIndex, AMDOverdrive::AdapterCapabilities& caps);
+    int readActivity(int adapterIndex, ADLPMActivity *activity);
+    int readTemperature(int adapterIndex, int thermalControllerIndex, int *millidegreesCelsius);
+    int readFanSpeed(int adapterIndex, int thermalControllerIndex, AMDOverdrive::FanSpeedValueType type, int *value);
+    int writeFanSpeed(int adapterIndex, int thermalControllerIndex, AMDOverdrive::FanSpeedValueType type, int value);
+    int resetFanSpeed(int adapterIndex, int thermalControllerIndex);
+    int readPowerControl(int adapterIndex, int *current, int *defaultValue);
+    int writePowerControl(int adapterIndex, int value);
+    int readPerformanceLevels(int adapterIndex, const AMDOverdrive::AdapterCapabilities& caps,
+                              AMDOverdrive::PerformanceLevelInfo *levels, int capacity, int *count);
+    int writePerformanceLevels(int adapterIndex, const AMDOverdrive::AdapterCapabilities& caps,
+                               AMDOverdrive::PerformanceLevelEdit *edits, int count);
+    int performanceLevelRange(const AMDOverdrive::AdapterCapabilities& caps, AMDOverdrive::PerformanceLevelField field,
+                              AMDOverdrive::ValueRange *range);
+
+private:
+    ADL_OVERDRIVE5_THERMALDEVICES_ENUM _thermalDevicesEnum;
+    ADL_OVERDRIVE5_FANSPEEDINFO_GET _fanSpeedInfoGet;
+    ADL_OVERDRIVE5_CURRENTACTIVITY_GET _currentActivityGet;
+    ADL_OVERDRIVE5_TEMPERATURE_GET _temperatureGet;
+    ADL_OVERDRIVE5_FANSPEED_GET _fanSpeedGet;
+    ADL_OVERDRIVE5_FANSPEED_SET _fanSpeedSet;
+    ADL_OVERDRIVE5_FANSPEEDTODEFAULT_SET _fanSpeedToDefaultSet;
+    ADL_OVERDRIVE5_POWERCONTROL_CAPS _powerControlCaps;
+    ADL_OVERDRIVE5_POWERCONTROLINFO_GET _powerControlInfoGet;
+    ADL_OVERDRIVE5_POWERCONTROL_GET _powerControlGet;
+    ADL_OVERDRIVE5_POWERCONTROL_SET _powerControlSet;
+    ADL_OVERDRIVE5_ODPERFORMANCELEVELS_GET _performanceLevelsGet;
+    ADL_OVERDRIVE5_ODPERFORMANCELEVELS_SET _performanceLevelsSet;
+};
+
+/** Overdrive 6, using ADL_Overdrive6_*. */
+class Overdrive6Backend : public OverdriveBackend {
+public:
+    Overdrive6Backend(AMDOverdrive& overdrive, const ADLFunctionTable& adl);
+
+    int version() const;
+    void queryCapabilities(int adapterIndex, AMDOverdrive::AdapterCapabilities& caps);
+    void queryThermalControllers(int adapterIndex, AMDOverdrive::AdapterCapabilities& caps);
+    int readActivity(int adapterIndex, ADLPMActivity *activity);
+    int readTemperature(int adapterIndex, int thermalControllerIndex, int *millidegreesCelsius);
+    int readFanSpeed(int adapterIndex, int thermalControllerIndex, AMDOverdrive::FanSpeedValueType type, int *value);
+    void sampleFanSpeeds(int adapterIndex, const AMDOverdrive::AdapterCapabilities& caps, AMDOverdrive::AdapterSample& sample);
+    int writeFanSpeed(int adapterIndex, int thermalControllerIndex, AMDOverdrive::FanSpeedValueType type, int value);
+    int readPowerControl(int adapterIndex, int *current, int *defaultValue);
+    int writePowerControl(int adapterIndex, int value);
+    int readPerformanceLevels(int adapterIndex, const AMDOverdrive::AdapterCapabilities& caps,
+                              AMDOverdrive::PerformanceLevelInfo *levels, int capacity, int *count);
+    int writePerformanceLevels(int adapterIndex, const AMDOverdrive::AdapterCapabilities& caps,
+                               AMDOverdrive::PerformanceLevelEdit *edits, int count);
+    int performanceLevelRange(const AMDOverdrive::AdapterCapabilities& caps, AMDOverdrive::PerformanceLevelField field,
+                              AMDOverdrive::ValueRange *range);
+
+private:
+    int readFanSpeedInfo(int adapterIndex, ADLOD6FanSpeedInfo *fanSpeedInfo);
+
+    ADL_OVERDRIVE6_CURRENTSTATUS_GET _currentStatusGet;
+    ADL_OVERDRIVE6_TEMPERATURE_GET _temperatureGet;
+    ADL_OVERDRIVE6_FANSPEED_GET _fanSpeedGet;
+    ADL_OVERDRIVE6_FANSPEED_SET _fanSpeedSet;
+    ADL_OVERDRIVE6_POWERCONTROL_CAPS _powerControlCaps;
+    ADL_OVERDRIVE6_POWERCONTROLINFO_GET _powerControlInfoGet;
+    ADL_OVERDRIVE6_POWERCONTROL_GET _powerControlGet;
+    ADL_OVERDRIVE6_POWERCONTROL_SET _powerControlSet;
+    ADL_OVERDRIVE6_CAPABILITIES_GET _capabilitiesGet;
+    ADL_OVERDRIVE6_STATEINFO_GET _stateInfoGet;
+    ADL_OVERDRIVE6_STATE_SET _stateSet;
+    ADL_OVERDRIVE6_THERMALCONTROLLER_CAPS _thermalControllerCaps;
+};
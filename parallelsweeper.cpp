@@ -0,0 +1,154 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+//    This file is part of QtAMD.                                            //
+//    Copyright (C) 2015-2016 Jacob Dawid, jacob@omg-it.works                //
+//                                                                           //
+//    QtAMD is free software: you can redistribute it and/or modify          //
+//    it under the terms of the GNU Affero General Public License as         //
+//    published by the Free Software Foundation, either version 3 of the     //
+//    License, or (at your option) any later version.                        //
+//                                                                           //
+//    QtAMD is distributed in the hope that it will be useful,               //
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of         //
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          //
+//    GNU Affero General Public License for more details.                    //
+//                                                                           //
+//    You should have received a copy of the GNU General Public License      //
+//    along with QtAMD. If not, see <http://www.gnu.org/licenses/>.          //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "parallelsweeper.h"
+
+#include <QDateTime>
+
+namespace {
+
+// Functions a sweep calls, including the capability queries made when a
+// worker first samples a GPU.
+const ADLFunction::Id sweepFunctions[] = {
+    ADLFunction::ADL_Overdrive_Caps,
+    ADLFunction::ADL_Overdrive5_ODParameters_Get,
+    ADLFunction::ADL_Overdrive5_PowerControl_Caps,
+    ADLFunction::ADL_Overdrive5_PowerControlInfo_Get,
+    ADLFunction::ADL_Overdrive5_ThermalDevices_Enum,
+    ADLFunction::ADL_Overdrive5_FanSpeedInfo_Get,
+    ADLFunction::ADL_Overdrive5_CurrentActivity_Get,
+    ADLFunction::ADL_Overdrive5_Temperature_Get,
+    ADLFunction::ADL_Overdrive5_FanSpeed_Get,
+    ADLFunction::ADL_Overdrive5_PowerControl_Get,
+    ADLFunction::ADL_Overdrive5_ODPerformanceLevels_Get,
+    ADLFunction::ADL_Overdrive6_Capabilities_Get,
+    ADLFunction::ADL_Overdrive6_PowerControl_Caps,
+    ADLFunction::ADL_Overdrive6_PowerControlInfo_Get,
+    ADLFunction::ADL_Overdrive6_ThermalController_Caps,
+    ADLFunction::ADL_Overdrive6_CurrentStatus_Get,
+    ADLFunction::ADL_Overdrive6_Temperature_Get,
+    ADLFunction::ADL_Overdrive6_FanSpeed_Get,
+    ADLFunction::ADL_Overdrive6_PowerControl_Get,
+    ADLFunction::ADL_Overdrive6_StateInfo_Get
+};
+
+// Workers may only sample at the same time if none of their calls falls
+// back to the global context.
+bool canSweepInParallel(const AMDOverdrive& overdrive) {
+    for(size_t i = 0; i < sizeof(sweepFunctions) / sizeof(ADLFunction::Id); i++) {
+        if(overdrive.isFunctionAvailable(sweepFunctions[i]) && !overdrive.usesPrivateContext(sweepFunctions[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+class ParallelSweeper::Worker : public QRunnable {
+public:
+    // Enumerates the adapters if topology is null.
+    Worker(const QSharedPointer<const AdapterTopology>& topology, const QString& libraryPath)
+        : _overdrive(topology, libraryPath),
+          _samples(0) {
+        setAutoDelete(false);
+    }
+
+    AMDOverdrive& overdrive() {
+        return _overdrive;
+    }
+
+    // Positions of this worker's GPUs in the snapshot.
+    void addSlot(int slot, int adapterIndex) {
+        _slots.append(slot);
+        _adapters.append(adapterIndex);
+    }
+
+    void setSamples(AMDOverdrive::AdapterSample *samples) {
+        _samples = samples;
+    }
+
+    void run() {
+        for(int i = 0; i < _slots.size(); i++) {
+            _overdrive.sample(_adapters.at(i), _samples[_slots.at(i)]);
+        }
+    }
+
+private:
+    AMDOverdrive _overdrive;
+    QVector<int> _slots;
+    QVector<int> _adapters;
+    AMDOverdrive::AdapterSample *_samples;
+};
+
+ParallelSweeper::ParallelSweeper(int numberOfWorkers, const QString& libraryPath) {
+    Worker *first = new Worker(QSharedPointer<const AdapterTopology>(), libraryPath);
+    _workers.append(first);
+    _adapters = first->overdrive().activeGpus();
+
+    // The other workers share the first one's enumeration, and each only
+    // queries the capabilities of its own GPUs.
+    if(canSweepInParallel(first->overdrive())) {
+        QSharedPointer<const AdapterTopology> topology = first->overdrive().topology();
+        numberOfWorkers = qBound(1, numberOfWorkers, qMax(_adapters.size(), 1));
+        while(_workers.size() < numberOfWorkers) {
+            _workers.append(new Worker(topology, libraryPath));
+        }
+    }
+
+    // GPUs are dealt out in turn, so every worker gets a similar share.
+    for(int i = 0; i < _adapters.size(); i++) {
+        _workers.at(i % _workers.size())->addSlot(i, _adapters.at(i));
+    }
+
+    // The calling thread runs the first worker itself.
+    _pool.setMaxThreadCount(qMax(_workers.size() - 1, 1));
+    _pool.setExpiryTimeout(-1);
+}
+
+ParallelSweeper::~ParallelSweeper() {
+    _pool.waitForDone();
+    qDeleteAll(_workers);
+}
+
+int ParallelSweeper::numberOfWorkers() const {
+    return _workers.size();
+}
+
+const QVector<int>& ParallelSweeper::adapters() const {
+    return _adapters;
+}
+
+void ParallelSweeper::sweep(AMDOverdrive::RigSnapshot& snapshot) {
+    snapshot.timestamp = QDateTime::currentMSecsSinceEpoch();
+    // Resizing to the same number of adapters keeps the allocated storage.
+    // data() detaches here, so workers only write to their own samples.
+    snapshot.adapters.resize(_adapters.size());
+    AMDOverdrive::AdapterSample *samples = snapshot.adapters.data();
+
+    for(int i = 0; i < _workers.size(); i++) {
+        _workers.at(i)->setSamples(samples);
+    }
+    for(int i = 1; i < _workers.size(); i++) {
+        _pool.start(_workers.at(i));
+    }
+    _workers.at(0)->run();
+    _pool.waitForDone();
+}
@@ -0,0 +1,64 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+//    This file is part of QtAMD.                                            //
+//    Copyright (C) 2015-2016 Jacob Dawid, jacob@omg-it.works                //
+//                                                                           //
+//    QtAMD is free software: you can redistribute it and/or modify          //
+//    it under the terms of the GNU Affero General Public License as         //
+//    published by the Free Software Foundation, either version 3 of the     //
+//    License, or (at your option) any later version.                        //
+//                                                                           //
+//    QtAMD is distributed in the hope that it will be useful,               //
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of         //
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          //
+//    GNU Affero General Public License for more details.                    //
+//                                                                           //
+//    You should have received a copy of the GNU General Public License      //
+//    along with QtAMD. If not, see <http://www.gnu.org/licenses/>.          //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <QString>
+#include <QVector>
+#include <QThread>
+#include <QThreadPool>
+
+#include "amdoverdrive.h"
+
+/**
+ * Samples all active GPUs of a rig in parallel. Every worker owns an
+ * AMDOverdrive, and with it an ADL2 context of its own, and always samples
+ * the same share of the GPUs, so calls on one adapter are never made from
+ * two threads at once. The rig is enumerated once, and the workers share
+ * its topology. sweep() fans the work out to a thread pool, waits for all
+ * workers and gathers their samples into one snapshot.
+ *
+ * Functions without an ADL2 variant use the driver's global context. If
+ * any function a sweep calls has none, a single worker samples all GPUs
+ * on the calling thread.
+ */
+class ParallelSweeper {
+public:
+    // Uses up to numberOfWorkers threads, but no more than there are GPUs.
+    ParallelSweeper(int numberOfWorkers = QThread::idealThreadCount(), const QString& libraryPath = QString());
+    ~ParallelSweeper();
+
+    int numberOfWorkers() const;
+    // Adapter indices of the sampled GPUs, one per GPU, in snapshot order.
+    const QVector<int>& adapters() const;
+
+    // Samples every GPU once. The snapshot is timestamped when the sweep
+    // starts. Reuse the same snapshot, so its storage is only allocated once.
+    void sweep(AMDOverdrive::RigSnapshot& snapshot);
+
+private:
+    Q_DISABLE_COPY(ParallelSweeper)
+
+    class Worker;
+
+    QVector<Worker*> _workers;
+    QVector<int> _adapters;
+    QThreadPool _pool;
+};
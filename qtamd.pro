@@ -1,13 +1,31 @@
 TEMPLATE = lib
 
-CONFIG += staticlib
+CONFIG += staticlib c++11
 TARGET = qtamd
 
 SOURCES += \
-    amdoverdrive.cpp
+    adaptertopology.cpp \
+    adlcontext.cpp \
+    adlmemory.cpp \
+    amdmonitor.cpp \
+    amdoverdrive.cpp \
+    asyncoverdrive.cpp \
+    overdrivebackend.cpp \
+    parallelsweeper.cpp \
+    telemetrysampler.cpp
 HEADERS += \
     adl/adl_defines.h \
     adl/adl_sdk.h \
     adl/adl_structures.h \
+    adaptertopology.h \
+    adlcontext.h \
+    adlmemory.h \
+    adlresult.h \
+    amdmonitor.h \
     amdoverdrive.h \
-    adlfunctionpointers.h
+    asyncoverdrive.h \
+    adlfunctionpointers.h \
+    overdrivebackend.h \
+    parallelsweeper.h \
+    sampleringbuffer.h \
+    telemetrysampler.h
@@ -0,0 +1,135 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+//    This file is part of QtAMD.                                            //
+//    Copyright (C) 2015-2016 Jacob Dawid, jacob@omg-it.works                //
+//                                                                           //
+//    QtAMD is free software: you can redistribute it and/or modify          //
+//    it under the terms of the GNU Affero General Public License as         //
+//    published by the Free Software Foundation, either version 3 of the     //
+//    License, or (at your option) any later version.                        //
+//                                                                           //
+//    QtAMD is distributed in the hope that it will be useful,               //
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of         //
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          //
+//    GNU Affero General Public License for more details.                    //
+//                                                                           //
+//    You should have received a copy of the GNU General Public License      //
+//    along with QtAMD. If not, see <http://www.gnu.org/licenses/>.          //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <Qt>
+
+#include <atomic>
+#include <string.h>
+#include <type_traits>
+
+/**
+ * Fixed-capacity ring buffer with a single producer and any number of
+ * consumers. Neither side takes a lock: every slot is guarded by a sequence
+ * number, and readers retry if the producer overwrote a slot while they
+ * were copying it. T must be trivially copyable.
+ */
+template<typename T>
+class SampleRingBuffer {
+public:
+    explicit SampleRingBuffer(int capacity)
+        : _capacity(qMax(capacity, 1)),
+          _slots(new Slot[qMax(capacity, 1)]),
+          _written(0) {
+        for(int i = 0; i < _capacity; i++) {
+            _slots[i].sequence.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    ~SampleRingBuffer() {
+        delete[] _slots;
+    }
+
+    int capacity() const {
+        return _capacity;
+    }
+
+    /** Total number of values pushed so far. */
+    quint64 count() const {
+        return _written.load(std::memory_order_acquire);
+    }
+
+    /** Publishes a value. Must only be called from the producer thread. */
+    void push(const T& value) {
+        quint64 index = _written.load(std::memory_order_relaxed);
+        Slot& slot = _slots[index % _capacity];
+
+        // An odd sequence number marks the slot as being written.
+        slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy(&slot.value, &value, sizeof(T));
+        slot.sequence.store(2 * index + 2, std::memory_order_release);
+
+        _written.store(index + 1, std::memory_order_release);
+    }
+
+    /** Copies the most recent value. Returns false if nothing was pushed yet. */
+    bool latest(T& value) const {
+        for(;;) {
+            quint64 written = count();
+            if(written == 0) {
+                return false;
+            }
+            if(read(written - 1, value)) {
+                return true;
+            }
+        }
+    }
+
+    /**
+     * Copies up to maximum of the most recent values, newest first, and
+     * returns how many have been copied.
+     */
+    int history(T *values, int maximum) const {
+        quint64 written = count();
+        quint64 available = qMin<quint64>(written, _capacity);
+        int n = 0;
+        for(quint64 i = 0; i < available && n < maximum; i++) {
+            // Stop once the producer has overwritten older values.
+            if(!read(written - 1 - i, values[n])) {
+                break;
+            }
+            n++;
+        }
+        return n;
+    }
+
+private:
+    Q_DISABLE_COPY(SampleRingBuffer)
+
+#if __GNUC__ >= 5 || defined(_MSC_VER)
+    Q_STATIC_ASSERT(std::is_trivially_copyable<T>::value);
+#endif
+
+    struct Slot {
+        std::atomic<quint64> sequence;
+        T value;
+    };
+
+    /**
+     * Copies the value with the given index. Fails if the producer has
+     * overwritten the slot before or while it was copied.
+     */
+    bool read(quint64 index, T& value) const {
+        const Slot& slot = _slots[index % _capacity];
+        quint64 expected = 2 * index + 2;
+        if(slot.sequence.load(std::memory_order_acquire) != expected) {
+            return false;
+        }
+        memcpy(&value, &slot.value, sizeof(T));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return slot.sequence.load(std::memory_order_relaxed) == expected;
+    }
+
+    const int _capacity;
+    Slot *_slots;
+    std::atomic<quint64> _written;
+};
@@ -0,0 +1,117 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+//    This file is part of QtAMD.                                            //
+//    Copyright (C) 2015-2016 Jacob Dawid, jacob@omg-it.works                //
+//                                                                           //
+//    QtAMD is free software: you can redistribute it and/or modify          //
+//    it under the terms of the GNU Affero General Public License as         //
+//    published by the Free Software Foundation, either version 3 of the     //
+//    License, or (at your option) any later version.                        //
+//                                                                           //
+//    QtAMD is distributed in the hope that it will be useful,               //
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of         //
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          //
+//    GNU Affero General Public License for more details.                    //
+//                                                                           //
+//    You should have received a copy of the GNU General Public License      //
+//    along with QtAMD. If not, see <http://www.gnu.org/licenses/>.          //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+
+#include "telemetrysampler.h"
+
+#include <QElapsedTimer>
+
+TelemetrySampler::TelemetrySampler(int intervalMilliseconds, int historyCapacity)
+    : _interval(qMax(intervalMilliseconds, 1)),
+      _stopRequested(0),
+      _sweeps(0) {
+    _adapters = _overdrive.activeGpus();
+    for(int i = 0; i < _adapters.size(); i++) {
+        _ringIndex.insert(_adapters.at(i), i);
+        _rings.append(new AdapterSampleRing(historyCapacity));
+    }
+    // Allocate the snapshot up front, so sampling doesn't allocate.
+    _snapshot.adapters.resize(_adapters.size());
+}
+
+TelemetrySampler::~TelemetrySampler() {
+    stop();
+    qDeleteAll(_rings);
+}
+
+void TelemetrySampler::setInterval(int milliseconds) {
+    _interval.store(qMax(milliseconds, 1));
+    _wakeUp.wakeAll();
+}
+
+int TelemetrySampler::interval() const {
+    return _interval.load();
+}
+
+void TelemetrySampler::stop() {
+    _mutex.lock();
+    _stopRequested.store(1);
+    _wakeUp.wakeAll();
+    _mutex.unlock();
+    wait();
+    // Allow the sampler to be started again.
+    _stopRequested.store(0);
+}
+
+const QVector<int>& TelemetrySampler::adapters() const {
+    return _adapters;
+}
+
+bool TelemetrySampler::latest(int adapterIndex, AMDOverdrive::AdapterSample& sample) const {
+    const AdapterSampleRing *adapterRing = ring(adapterIndex);
+    return adapterRing ? adapterRing->latest(sample) : false;
+}
+
+int TelemetrySampler::history(int adapterIndex, AMDOverdrive::AdapterSample *samples, int maximum) const {
+    const AdapterSampleRing *adapterRing = ring(adapterIndex);
+    return adapterRing ? adapterRing->history(samples, maximum) : 0;
+}
+
+quint64 TelemetrySampler::numberOfSweeps() const {
+    return _sweeps.load();
+}
+
+void TelemetrySampler::run() {
+    QElapsedTimer timer;
+    timer.start();
+    qint64 nextSweep = 0;
+
+    while(!_stopRequested.load()) {
+        _overdrive.snapshot(_snapshot);
+        // The set of active adapters is fixed at construction, only publish
+        // samples of adapters we have a ring for.
+        for(int i = 0; i < _snapshot.adapters.size(); i++) {
+            int index = _ringIndex.value(_snapshot.adapters.at(i).adapterIndex, -1);
+            if(index >= 0) {
+                _rings.at(index)->push(_snapshot.adapters.at(i));
+            }
+        }
+        _sweeps.fetchAndAddRelease(1);
+
+        // Keep a steady rate, but don't try to catch up after slow sweeps.
+        nextSweep = qMax(nextSweep + _interval.load(), timer.elapsed());
+        _mutex.lock();
+        while(!_stopRequested.load()) {
+            // Read the clock once. If the deadline passed between two reads,
+            // the timeout would wrap around, and wait() would never return.
+            qint64 remaining = nextSweep - timer.elapsed();
+            if(remaining <= 0) {
+                break;
+            }
+            _wakeUp.wait(&_mutex, (unsigned long)remaining);
+        }
+        _mutex.unlock();
+    }
+}
+
+const TelemetrySampler::AdapterSampleRing *TelemetrySampler::ring(int adapterIndex) const {
+    int index = _ringIndex.value(adapterIndex, -1);
+    return index >= 0 ? _rings.at(index) : 0;
+}
@@ -0,0 +1,78 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+//    This file is part of QtAMD.                                            //
+//    Copyright (C) 2015-2016 Jacob Dawid, jacob@omg-it.works                //
+//                                                                           //
+//    QtAMD is free software: you can redistribute it and/or modify          //
+//    it under the terms of the GNU Affero General Public License as         //
+//    published by the Free Software Foundation, either version 3 of the     //
+//    License, or (at your option) any later version.                        //
+//                                                                           //
+//    QtAMD is distributed in the hope that it will be useful,               //
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of         //
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          //
+//    GNU Affero General Public License for more details.                    //
+//                                                                           //
+//    You should have received a copy of the GNU General Public License      //
+//    along with QtAMD. If not, see <http://www.gnu.org/licenses/>.          //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QVector>
+#include <QHash>
+#include <QAtomicInt>
+
+#include "amdoverdrive.h"
+#include "sampleringbuffer.h"
+
+/**
+ * Samples all active GPUs on a dedicated thread at a fixed interval.
+ * Samples are published into one lock-free ring buffer per adapter, so
+ * readers on other threads never wait for the driver.
+ */
+class TelemetrySampler : public QThread {
+public:
+    typedef SampleRingBuffer<AMDOverdrive::AdapterSample> AdapterSampleRing;
+
+    TelemetrySampler(int intervalMilliseconds = 1000, int historyCapacity = 256);
+    ~TelemetrySampler();
+
+    void setInterval(int milliseconds);
+    int interval() const;
+
+    void stop();
+
+    // The adapters being sampled, one per active GPU, fixed at construction.
+    const QVector<int>& adapters() const;
+
+    // Lock-free reads, safe to call from any thread.
+    bool latest(int adapterIndex, AMDOverdrive::AdapterSample& sample) const;
+    int history(int adapterIndex, AMDOverdrive::AdapterSample *samples, int maximum) const;
+    quint64 numberOfSweeps() const;
+
+protected:
+    void run();
+
+private:
+    const AdapterSampleRing *ring(int adapterIndex) const;
+
+    // Only used from the sampling thread once it has been started.
+    AMDOverdrive _overdrive;
+    AMDOverdrive::RigSnapshot _snapshot;
+
+    QVector<int> _adapters;
+    QVector<AdapterSampleRing*> _rings;
+    QHash<int, int> _ringIndex;
+
+    QAtomicInt _interval;
+    QAtomicInt _stopRequested;
+    QAtomicInteger<quint64> _sweeps;
+    QMutex _mutex;
+    QWaitCondition _wakeUp;
+};
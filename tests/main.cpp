@@ -0,0 +1,711 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+//    This file is part of QtAMD.                                            //
+//    Copyright (C) 2015-2016 Jacob Dawid, jacob@omg-it.works                //
+//                                                                           //
+//    QtAMD is free software: you can redistribute it and/or modify          //
+//    it under the terms of the GNU Affero General Public License as         //
+//    published by the Free Software Foundation, either version 3 of the     //
+//    License, or (at your option) any later version.                        //
+//                                                                           //
+//    QtAMD is distributed in the hope that it will be useful,               //
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of         //
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          //
+//    GNU Affero General Public License for more details.                    //
+//                                                                           //
+//    You should have received a copy of the GNU General Public License      //
+//    along with QtAMD. If not, see <http://www.gnu.org/licenses/>.          //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+
+// qtamd-tests checks QtAMD against the mock ADL library. Each test prints
+// the checks that failed, and the exit code is the number of failed tests,
+// so `make check` fails if any test does.
+//
+// Usage: qtamd-tests [--library path] [test name...]
+
+#include "amdoverdrive.h"
+#include "adlmemory.h"
+#include "amdmonitor.h"
+#include "asyncoverdrive.h"
+#include "parallelsweeper.h"
+#include "telemetrysampler.h"
+
+#include <QByteArray>
+#include <QThread>
+
+#include <dlfcn.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Counting allocations, as in qtamd-bench.
+static volatile bool countingAllocations = false;
+static unsigned long long numberOfAllocations = 0;
+
+#if defined(__GLIBC__)
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *p, size_t size);
+void __libc_free(void *p);
+
+void *malloc(size_t size) {
+    if(countingAllocations) { __sync_fetch_and_add(&numberOfAllocations, 1); }
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size) {
+    if(countingAllocations) { __sync_fetch_and_add(&numberOfAllocations, 1); }
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *p, size_t size) {
+    if(countingAllocations) { __sync_fetch_and_add(&numberOfAllocations, 1); }
+    return __libc_realloc(p, size);
+}
+
+void free(void *p) {
+    __libc_free(p);
+}
+}
+#define QTAMD_TESTS_COUNT_ALLOCATIONS
+#endif
+
+typedef unsigned long long (*NumberOfCallsFunction)();
+static NumberOfCallsFunction mockNumberOfCalls = 0;
+static NumberOfCallsFunction mockNumberOfLegacyCalls = 0;
+typedef void (*SetFailingFunctionsFunction)(const char *names);
+static SetFailingFunctionsFunction mockSetFailingFunctions = 0;
+
+static unsigned long long driverCalls() {
+    return mockNumberOfCalls ? mockNumberOfCalls() : 0;
+}
+
+static int failedChecks = 0;
+
+#define CHECK(condition) check((condition), #condition, __FILE__, __LINE__)
+#define CHECK_EQUAL(actual, expected) checkEqual((long long)(actual), (long long)(expected), #actual, __FILE__, __LINE__)
+
+static bool check(bool condition, const char *expression, const char *file, int line) {
+    if(!condition) {
+        printf("    %s:%d: %s\n", file, line, expression);
+        failedChecks++;
+    }
+    return condition;
+}
+
+static bool checkEqual(long long actual, long long expected, const char *expression, const char *file, int line) {
+    if(actual != expected) {
+        printf("    %s:%d: %s is %lld, expected %lld\n", file, line, expression, actual, expected);
+        failedChecks++;
+    }
+    return actual == expected;
+}
+
+// Configures the mock rig. The mock reads it when a context is created, so
+// call this before creating an AMDOverdrive.
+static void setUpRig(int overdriveVersion, int performanceLevels) {
+    qputenv("QTAMD_MOCK_ADAPTERS", "1");
+    qputenv("QTAMD_MOCK_OD_VERSION", QByteArray::number(overdriveVersion));
+    qputenv("QTAMD_MOCK_PERFORMANCE_LEVELS", QByteArray::number(performanceLevels));
+}
+
+static void testPerformanceLevelsDontAllocate() {
+#if defined(QTAMD_TESTS_COUNT_ALLOCATIONS)
+    const int versions[] = { 5, 6 };
+    for(size_t i = 0; i < sizeof(versions) / sizeof(int); i++) {
+        setUpRig(versions[i], 3);
+        AMDOverdrive overdrive;
+        AMDOverdrive::PerformanceLevelInfo levels[AMDOverdrive::MaxPerformanceLevels];
+        // Caches the capabilities.
+        CHECK(overdrive.performanceLevels(0, levels, AMDOverdrive::MaxPerformanceLevels).ok());
+
+        unsigned long long allocationsBefore = numberOfAllocations;
+        unsigned long long callsBefore = driverCalls();
+        countingAllocations = true;
+        ADLResult<int> count;
+        for(int call = 0; call < 100; call++) {
+            count = overdrive.performanceLevels(0, levels, AMDOverdrive::MaxPerformanceLevels);
+        }
+        countingAllocations = false;
+
+        CHECK_EQUAL(count.returnCode(), ADL_OK);
+        CHECK_EQUAL(count.value(), versions[i] == 5 ? 3 : 2);
+        CHECK_EQUAL(numberOfAllocations - allocationsBefore, 0);
+        if(mockNumberOfCalls) {
+            CHECK_EQUAL(driverCalls() - callsBefore, 200);
+        }
+    }
+#else
+    printf("    skipped, allocations can only be counted with glibc\n");
+#endif
+}
+
+static void testMoreThanMaxPerformanceLevels() {
+    setUpRig(5, 12);
+    AMDOverdrive overdrive;
+
+    ADLResult<QList<AMDOverdrive::PerformanceLevelInfo> > levels = overdrive.performanceLevels(0);
+    CHECK_EQUAL(levels.returnCode(), ADL_OK);
+    if(!CHECK_EQUAL(levels.value().size(), 12)) {
+        return;
+    }
+
+    AMDOverdrive::PerformanceLevelInfo buffer[AMDOverdrive::MaxPerformanceLevels];
+    CHECK_EQUAL(overdrive.performanceLevels(0, buffer, AMDOverdrive::MaxPerformanceLevels).returnCode(), ADL_ERR_INVALID_PARAM_SIZE);
+
+    // The highest level only exists past the stack buffer.
+    int clockMHz = levels.value().last().stock.iEngineClock / 100 - 10;
+    CHECK(overdrive.setCoreClock(0, 11, clockMHz));
+    levels = overdrive.performanceLevels(0);
+    CHECK_EQUAL(levels.value().value(11).current.iEngineClock, clockMHz * 100);
+}
+
+static void testLeakedBufferDoesntPinArena() {
+    ADLMemory::setAllocator(ADLMemory::arenaAllocator());
+    ADLMemory::retireArena();
+    ADLMemory::resetCounters();
+
+    // A buffer ADL never frees keeps the arena from rewinding...
+    void *leaked = ADLMemory::allocate(ADLMemory::ArenaSize / 2);
+    ADLMemory::free(ADLMemory::allocate(ADLMemory::ArenaSize / 4));
+    ADLMemory::free(ADLMemory::allocate(ADLMemory::ArenaSize / 4));
+    CHECK_EQUAL(ADLMemory::counters().arenaOverflows, 1);
+
+    // ...until a context is destroyed, after which a new arena is used.
+    ADLMemory::retireArena();
+    CHECK_EQUAL(ADLMemory::counters().retiredArenas, 1);
+    ADLMemory::free(ADLMemory::allocate(ADLMemory::ArenaSize / 4));
+    ADLMemory::free(ADLMemory::allocate(ADLMemory::ArenaSize / 4));
+    CHECK_EQUAL(ADLMemory::counters().arenaOverflows, 1);
+    CHECK_EQUAL(ADLMemory::counters().arenaAllocations, 4);
+
+    // The old arena goes away with its last buffer.
+    ADLMemory::free(leaked);
+    CHECK_EQUAL(ADLMemory::counters().retiredArenas, 0);
+    CHECK_EQUAL(ADLMemory::counters().outstandingAllocations, 0);
+}
+
+static void testReinitializeFailureIsReported() {
+    setUpRig(5, 3);
+    AMDOverdrive overdrive;
+    CHECK_EQUAL(overdrive.contextMode(), AMDOverdrive::PrivateContext);
+
+    qputenv("QTAMD_MOCK_FAIL", "ADL_Main_Control_Create");
+    CHECK_EQUAL(overdrive.reinitialize(), ADL_ERR_NOT_SUPPORTED);
+    qputenv("QTAMD_MOCK_FAIL", "");
+
+    // No silent fallback to the global context.
+    CHECK_EQUAL(overdrive.contextMode(), AMDOverdrive::PrivateContext);
+    CHECK(!overdrive.isInitialized());
+    CHECK_EQUAL(overdrive.temperatureMillidegreesCelsius(0, 0).returnCode(), ADL_ERR_NOT_INIT);
+
+    CHECK_EQUAL(overdrive.reinitialize(), ADL_OK);
+    CHECK(overdrive.isInitialized());
+    CHECK_EQUAL(overdrive.temperatureMillidegreesCelsius(0, 0).returnCode(), ADL_OK);
+}
+
+// Releases the last reference to the shared context.
+class LastUser : public QThread {
+protected:
+    void run() {
+        AMDOverdrive overdrive(QString(), AMDOverdrive::GlobalContext);
+    }
+};
+
+static void testContextIsCreatedAfterDestroy() {
+    setUpRig(5, 3);
+    qputenv("QTAMD_MOCK_DESTROY_LATENCY_US", "200000");
+    LastUser lastUser;
+    lastUser.start();
+
+    // Acquires the context while the last user still destroys it, which
+    // must wait instead of creating a context the destroy then tears down.
+    QThread::msleep(50);
+    AMDOverdrive overdrive(QString(), AMDOverdrive::GlobalContext);
+    lastUser.wait();
+    qputenv("QTAMD_MOCK_DESTROY_LATENCY_US", "0");
+
+    CHECK(overdrive.isInitialized());
+    CHECK_EQUAL(overdrive.numberOfAdapters().returnCode(), ADL_OK);
+}
+
+static void testPrivateContextEnumeratesThermalControllers() {
+    setUpRig(5, 3);
+    qputenv("QTAMD_MOCK_THERMAL_CONTROLLERS", "2");
+    AMDOverdrive overdrive;
+    qputenv("QTAMD_MOCK_THERMAL_CONTROLLERS", "1");
+    if(!CHECK(mockNumberOfLegacyCalls) || !CHECK_EQUAL(overdrive.contextMode(), AMDOverdrive::PrivateContext)) {
+        return;
+    }
+
+    // Every mock entry point has an ADL2 variant, so nothing may go
+    // through the global context.
+    unsigned long long legacyCallsBefore = mockNumberOfLegacyCalls();
+    overdrive.refreshCapabilities();
+    CHECK_EQUAL(overdrive.thermalControllersInfo(0).value().size(), 2);
+    CHECK_EQUAL(mockNumberOfLegacyCalls() - legacyCallsBefore, 0);
+
+    // Running out of controllers isn't a failure.
+    QList<AMDOverdrive::ErrorCounter> errors = overdrive.errorCounters();
+    for(int i = 0; i < errors.size(); i++) {
+        CHECK(errors.at(i).function != ADLFunction::ADL_Overdrive5_ThermalDevices_Enum);
+    }
+}
+
+static void testRigWriteInvalidatesAdapterReads() {
+    setUpRig(5, 3);
+    // Keeps the reads queued while the driver thread is busy.
+    qputenv("QTAMD_MOCK_LATENCY_US", "20000");
+    AsyncOverdrive async;
+    QFuture<ADLResult<int> > first = async.read(&AMDOverdrive::temperatureMillidegreesCelsius, 0, 0);
+    QFuture<ADLResult<int> > shared = async.read(&AMDOverdrive::temperatureMillidegreesCelsius, 0, 0);
+    QFuture<int> reinitialize = async.write(&AMDOverdrive::reinitialize);
+    QFuture<ADLResult<int> > second = async.read(&AMDOverdrive::temperatureMillidegreesCelsius, 0, 0);
+    second.waitForFinished();
+    qputenv("QTAMD_MOCK_LATENCY_US", "0");
+
+    CHECK(shared == first);
+    CHECK(!(second == first));
+    CHECK_EQUAL(async.counters().coalescedReads, 1);
+    CHECK_EQUAL(reinitialize.result(), ADL_OK);
+    CHECK_EQUAL(second.result().returnCode(), ADL_OK);
+}
+
+static void testOutputsOfOneGpuShareAQueue() {
+    setUpRig(5, 3);
+    qputenv("QTAMD_MOCK_OUTPUTS_PER_ADAPTER", "2");
+    qputenv("QTAMD_MOCK_LATENCY_US", "20000");
+    AsyncOverdrive async;
+    // Waits for the driver thread to load the topology.
+    async.read(&AMDOverdrive::numberOfAdapters).waitForFinished();
+
+    // Adapters 0 and 1 are outputs of the same GPU, so a write through
+    // adapter 1 ends sharing reads through adapter 0.
+    QFuture<ADLResult<int> > first = async.read(&AMDOverdrive::temperatureMillidegreesCelsius, 0, 0);
+    QFuture<ADLResult<int> > shared = async.read(&AMDOverdrive::temperatureMillidegreesCelsius, 0, 0);
+    QFuture<bool> write = async.write(&AMDOverdrive::setFanSpeedValue, 1, 0, AMDOverdrive::Percent, 50, false);
+    QFuture<ADLResult<int> > second = async.read(&AMDOverdrive::temperatureMillidegreesCelsius, 0, 0);
+    second.waitForFinished();
+    qputenv("QTAMD_MOCK_LATENCY_US", "0");
+    qputenv("QTAMD_MOCK_OUTPUTS_PER_ADAPTER", "1");
+
+    CHECK(shared == first);
+    CHECK(!(second == first));
+    CHECK_EQUAL(async.counters().coalescedReads, 1);
+    CHECK(write.result());
+}
+
+static void testSamplerKeepsSampling() {
+    setUpRig(5, 3);
+    TelemetrySampler sampler(1);
+    if(!CHECK_EQUAL(sampler.adapters().size(), 1)) {
+        return;
+    }
+    sampler.start();
+
+    // At a 1 ms interval the deadline often passes while the sampler is
+    // still checking it, which must not make it wait until stopped.
+    quint64 sweeps = sampler.numberOfSweeps();
+    for(int i = 0; i < 10; i++) {
+        QThread::msleep(50);
+        CHECK(sampler.numberOfSweeps() > sweeps);
+        sweeps = sampler.numberOfSweeps();
+    }
+    sampler.stop();
+
+    AMDOverdrive::AdapterSample sample;
+    CHECK(sampler.latest(sampler.adapters().first(), sample));
+}
+
+static void testMonitorReportsChangesOfOneDeadband() {
+    setUpRig(5, 3);
+    // Shares the mock rig with the monitor, to change what it polls.
+    AMDOverdrive driver;
+    AMDMonitor monitor;
+    if(!CHECK_EQUAL(monitor.adapters().size(), 1)) {
+        return;
+    }
+    int adapterIndex = monitor.adapters().first();
+    CHECK(driver.powerControlSet(adapterIndex, 0));
+    monitor.poll();
+    CHECK_EQUAL(monitor.reportedSample(adapterIndex).powerControl, 0);
+
+    // A change of exactly the default deadband of 1 is reported.
+    CHECK(driver.powerControlSet(adapterIndex, 1));
+    monitor.poll();
+    CHECK_EQUAL(monitor.reportedSample(adapterIndex).powerControl, 1);
+
+    monitor.setDeadband(AMDMonitor::PowerControl, 5);
+    CHECK(driver.powerControlSet(adapterIndex, 5));
+    monitor.poll();
+    CHECK_EQUAL(monitor.reportedSample(adapterIndex).powerControl, 1);
+    CHECK(driver.powerControlSet(adapterIndex, 6));
+    monitor.poll();
+    CHECK_EQUAL(monitor.reportedSample(adapterIndex).powerControl, 6);
+}
+
+static void testAsyncReadsConstMethodsAndConvertsArguments() {
+    setUpRig(5, 3);
+    qputenv("QTAMD_MOCK_LATENCY_US", "20000");
+    AsyncOverdrive async;
+    QFuture<bool> initialized = async.read(&AMDOverdrive::isInitialized);
+    QFuture<QVector<int> > gpus = async.read(&AMDOverdrive::activeGpus);
+
+    // The arguments are ints once converted, so the reads are identical.
+    QFuture<ADLResult<int> > first = async.read(&AMDOverdrive::temperatureMillidegreesCelsius, 0, 0);
+    QFuture<ADLResult<int> > converted = async.read(&AMDOverdrive::temperatureMillidegreesCelsius, 0, (short)0);
+    QFuture<ADLResult<int> > wide = async.read(&AMDOverdrive::temperatureMillidegreesCelsius, 0L, 0L);
+    first.waitForFinished();
+    qputenv("QTAMD_MOCK_LATENCY_US", "0");
+
+    CHECK(initialized.result());
+    CHECK_EQUAL(gpus.result().size(), 1);
+    CHECK(converted == first);
+    CHECK(wide == first);
+    CHECK_EQUAL(async.counters().coalescedReads, 2);
+    CHECK_EQUAL(async.priority(&AMDOverdrive::writeCounters), AsyncOverdrive::NormalPriority);
+    async.setPriority(&AMDOverdrive::writeCounters, AsyncOverdrive::BulkPriority);
+    CHECK_EQUAL(async.priority(&AMDOverdrive::writeCounters), AsyncOverdrive::BulkPriority);
+}
+
+static void testClockRangeRoundsInwards() {
+    setUpRig(5, 3);
+    // Minimum and maximum that aren't whole MHz.
+    qputenv("QTAMD_MOCK_ENGINE_CLOCK_MIN", "30050");
+    qputenv("QTAMD_MOCK_ENGINE_CLOCK_MAX", "149950");
+    AMDOverdrive overdrive;
+    qputenv("QTAMD_MOCK_ENGINE_CLOCK_MIN", "30000");
+    qputenv("QTAMD_MOCK_ENGINE_CLOCK_MAX", "150000");
+
+    ADLResult<AMDOverdrive::ValueRange> range = overdrive.performanceLevelRange(0, AMDOverdrive::CoreClock);
+    CHECK_EQUAL(range.returnCode(), ADL_OK);
+    CHECK_EQUAL(range.value().minimum, 301);
+    CHECK_EQUAL(range.value().maximum, 1499);
+
+    // Both ends are accepted by the driver.
+    CHECK(overdrive.setCoreClock(0, 0, range.value().minimum));
+    CHECK(overdrive.setCoreClock(0, 2, range.value().maximum));
+    CHECK(!overdrive.setCoreClock(0, 0, 300));
+}
+
+static void testSweepersShareOneEnumeration() {
+    setUpRig(5, 3);
+    qputenv("QTAMD_MOCK_ADAPTERS", "4");
+    unsigned long long callsBefore = driverCalls();
+    {
+        AMDOverdrive overdrive;
+    }
+    unsigned long long enumerationCalls = driverCalls() - callsBefore;
+
+    // The workers share the first one's enumeration, and query their GPUs'
+    // capabilities when they first sample them.
+    callsBefore = driverCalls();
+    ParallelSweeper sweeper(4);
+    CHECK_EQUAL(driverCalls() - callsBefore, enumerationCalls);
+    CHECK_EQUAL(sweeper.numberOfWorkers(), 4);
+
+    AMDOverdrive::RigSnapshot snapshot;
+    sweeper.sweep(snapshot);
+    qputenv("QTAMD_MOCK_ADAPTERS", "1");
+    if(!CHECK_EQUAL(snapshot.adapters.size(), 4)) {
+        return;
+    }
+    for(int i = 0; i < snapshot.adapters.size(); i++) {
+        CHECK_EQUAL(snapshot.adapters.at(i).adapterIndex, sweeper.adapters().at(i));
+        CHECK(snapshot.adapters.at(i).validFields & AMDOverdrive::TemperatureField);
+        CHECK(snapshot.adapters.at(i).validFields & AMDOverdrive::PowerControlField);
+    }
+}
+
+static AMDOverdrive::CircuitBreakerState circuitBreaker(const AMDOverdrive& overdrive, int adapterIndex, ADLFunction::Id function) {
+    QList<AMDOverdrive::CircuitBreakerState> states = overdrive.circuitBreakers();
+    for(int i = 0; i < states.size(); i++) {
+        if(states.at(i).adapterIndex == adapterIndex && states.at(i).function == function) {
+            return states.at(i);
+        }
+    }
+    AMDOverdrive::CircuitBreakerState state;
+    memset(&state, 0, sizeof(AMDOverdrive::CircuitBreakerState));
+    return state;
+}
+
+static void testCircuitBreakerTripsAndBacksOff() {
+    setUpRig(5, 3);
+    AMDOverdrive overdrive;
+    if(!CHECK(mockSetFailingFunctions)) {
+        return;
+    }
+    const ADLFunction::Id temperatureGet = ADLFunction::ADL_Overdrive5_Temperature_Get;
+    overdrive.setCircuitBreakerThreshold(3);
+    overdrive.setCircuitBreakerBackoff(100, 1000);
+
+    mockSetFailingFunctions("ADL_Overdrive5_Temperature_Get");
+    for(int i = 0; i < 3; i++) {
+        CHECK(!overdrive.isCircuitOpen(0, temperatureGet));
+        CHECK_EQUAL(overdrive.temperatureMillidegreesCelsius(0, 0).returnCode(), ADL_ERR_NOT_SUPPORTED);
+    }
+    CHECK(overdrive.isCircuitOpen(0, temperatureGet));
+
+    // While open, the driver isn't called.
+    unsigned long long callsBefore = driverCalls();
+    CHECK_EQUAL(overdrive.temperatureMillidegreesCelsius(0, 0).returnCode(), QTAMD_ERR_CIRCUIT_OPEN);
+    CHECK_EQUAL(driverCalls() - callsBefore, 0);
+    CHECK_EQUAL(circuitBreaker(overdrive, 0, temperatureGet).shortCircuitedCalls, 1);
+
+    // A failed probe doubles the back-off.
+    QThread::msleep(120);
+    CHECK_EQUAL(overdrive.temperatureMillidegreesCelsius(0, 0).returnCode(), ADL_ERR_NOT_SUPPORTED);
+    CHECK(overdrive.isCircuitOpen(0, temperatureGet));
+    CHECK(circuitBreaker(overdrive, 0, temperatureGet).retryInMilliseconds > 150);
+
+    // A successful probe closes the circuit.
+    mockSetFailingFunctions("");
+    QThread::msleep(220);
+    CHECK_EQUAL(overdrive.temperatureMillidegreesCelsius(0, 0).returnCode(), ADL_OK);
+    CHECK(!overdrive.isCircuitOpen(0, temperatureGet));
+    CHECK_EQUAL(overdrive.temperatureMillidegreesCelsius(0, 0).returnCode(), ADL_OK);
+}
+
+static void testTransactionCommitsInOneWrite() {
+    setUpRig(5, 3);
+    AMDOverdrive overdrive;
+    // Caches the capabilities.
+    CHECK(overdrive.performanceLevels(0).ok());
+
+    AMDOverdrive::PerformanceLevelTransaction transaction(0);
+    transaction.setCoreClock(0, 400);
+    transaction.setMemoryClock(0, 500);
+    transaction.setCoreClock(2, 1200);
+    transaction.setVoltage(2, 1100);
+    // Invalid edits don't keep the valid ones from being applied.
+    transaction.setCoreClock(3, 1000);
+
+    unsigned long long callsBefore = driverCalls();
+    CHECK_EQUAL(overdrive.commit(transaction), ADL_ERR_INVALID_PARAM);
+    // One read of the levels and one write of all of them.
+    CHECK_EQUAL(driverCalls() - callsBefore, 2);
+    const QVector<AMDOverdrive::PerformanceLevelEdit>& edits = transaction.edits();
+    for(int i = 0; i < 4; i++) {
+        CHECK_EQUAL(edits.at(i).returnCode, ADL_OK);
+    }
+    CHECK_EQUAL(edits.at(4).returnCode, ADL_ERR_INVALID_PARAM);
+
+    QList<AMDOverdrive::PerformanceLevelInfo> levels = overdrive.performanceLevels(0).value();
+    if(!CHECK_EQUAL(levels.size(), 3)) {
+        return;
+    }
+    CHECK_EQUAL(levels.at(0).current.iEngineClock, 40000);
+    CHECK_EQUAL(levels.at(0).current.iMemoryClock, 50000);
+    CHECK_EQUAL(levels.at(2).current.iEngineClock, 120000);
+    CHECK_EQUAL(levels.at(2).current.iVddc, 1100);
+    // Untouched fields keep their values.
+    CHECK_EQUAL(levels.at(1).current.iEngineClock, levels.at(1).stock.iEngineClock);
+}
+
+static void testEditsAreRangeCheckedAndSnapped() {
+    setUpRig(5, 3);
+    AMDOverdrive overdrive;
+    // Mock engine clocks run from 300 to 1500 MHz in steps of 5 MHz.
+    ADLResult<AMDOverdrive::ValueRange> range = overdrive.performanceLevelRange(0, AMDOverdrive::CoreClock);
+    CHECK_EQUAL(range.value().minimum, 300);
+    CHECK_EQUAL(range.value().maximum, 1500);
+    CHECK_EQUAL(range.value().step, 5);
+
+    AMDOverdrive::PerformanceLevelTransaction transaction(0);
+    transaction.setCoreClock(1, 1003);
+    transaction.setCoreClock(2, 1501);
+    CHECK_EQUAL(overdrive.commit(transaction), QTAMD_ERR_OUT_OF_RANGE);
+    const QVector<AMDOverdrive::PerformanceLevelEdit>& edits = transaction.edits();
+    CHECK_EQUAL(edits.at(0).returnCode, ADL_OK);
+    CHECK_EQUAL(edits.at(0).value, 1005);
+    CHECK_EQUAL(edits.at(1).returnCode, QTAMD_ERR_OUT_OF_RANGE);
+    CHECK_EQUAL(edits.at(1).allowedRange.maximum, 1500);
+    CHECK_EQUAL(overdrive.performanceLevels(0).value().value(1).current.iEngineClock, 100500);
+
+    // A rejected value never reaches the driver.
+    unsigned long long callsBefore = driverCalls();
+    CHECK(!overdrive.setCoreClock(0, 0, 299));
+    CHECK_EQUAL(driverCalls() - callsBefore, 0);
+}
+
+static void testUnchangedWritesAreSkipped() {
+    setUpRig(5, 3);
+    AMDOverdrive overdrive;
+    CHECK(overdrive.isPowerControlSupported(0));
+
+    unsigned long long callsBefore = driverCalls();
+    CHECK(overdrive.powerControlSet(0, 10));
+    CHECK_EQUAL(driverCalls() - callsBefore, 1);
+
+    // Unchanged, so skipped.
+    callsBefore = driverCalls();
+    CHECK(overdrive.powerControlSet(0, 10));
+    CHECK_EQUAL(driverCalls() - callsBefore, 0);
+
+    // Changed or forced, so written.
+    callsBefore = driverCalls();
+    CHECK(overdrive.powerControlSet(0, 11));
+    CHECK(overdrive.powerControlSet(0, 11, true));
+    CHECK_EQUAL(driverCalls() - callsBefore, 2);
+
+    // Fans are remembered per value type.
+    CHECK(overdrive.setFanSpeedValue(0, 0, AMDOverdrive::Percent, 60));
+    CHECK(overdrive.setFanSpeedValue(0, 0, AMDOverdrive::Percent, 60));
+    CHECK(overdrive.setFanSpeedValue(0, 0, AMDOverdrive::Rpm, 2000));
+
+    AMDOverdrive::WriteCounters counters = overdrive.writeCounters();
+    CHECK_EQUAL(counters.powerControlWrites, 3);
+    CHECK_EQUAL(counters.suppressedPowerControlWrites, 1);
+    CHECK_EQUAL(counters.fanSpeedWrites, 2);
+    CHECK_EQUAL(counters.suppressedFanSpeedWrites, 1);
+    CHECK_EQUAL(overdrive.powerControlGetCurrent(0).value(), 11);
+}
+
+static void testMetadataSurvivesSaveAndLoad() {
+    setUpRig(5, 3);
+    qputenv("QTAMD_MOCK_ADAPTERS", "2");
+    QList<AMDOverdrive::AdapterMetadata> saved;
+    {
+        AMDOverdrive overdrive;
+        saved = overdrive.metadata();
+    }
+    qputenv("QTAMD_MOCK_ADAPTERS", "1");
+    if(!CHECK_EQUAL(saved.size(), 2)) {
+        return;
+    }
+    CHECK_EQUAL(saved.at(0).validFields, AMDOverdrive::AllMetadataFields);
+
+    char fileName[64];
+    snprintf(fileName, sizeof(fileName), "/tmp/qtamd-tests-metadata-%d", (int)getpid());
+    CHECK(AMDOverdrive::saveMetadata(fileName, saved));
+    // Loading doesn't need the driver.
+    unsigned long long callsBefore = driverCalls();
+    QList<AMDOverdrive::AdapterMetadata> loaded;
+    CHECK(AMDOverdrive::loadMetadata(fileName, loaded));
+    CHECK_EQUAL(driverCalls() - callsBefore, 0);
+    unlink(fileName);
+
+    if(!CHECK_EQUAL(loaded.size(), saved.size())) {
+        return;
+    }
+    for(int i = 0; i < saved.size(); i++) {
+        const AMDOverdrive::AdapterMetadata& before = saved.at(i);
+        const AMDOverdrive::AdapterMetadata& after = loaded.at(i);
+        CHECK(after.udid == before.udid);
+        CHECK(after.name == before.name);
+        CHECK_EQUAL(after.busNumber, before.busNumber);
+        CHECK_EQUAL(after.validFields, before.validFields);
+        CHECK_EQUAL(after.adapterID, before.adapterID);
+        CHECK(strcmp(after.biosInfo.strPartNumber, before.biosInfo.strPartNumber) == 0);
+        CHECK(strcmp(after.biosInfo.strVersion, before.biosInfo.strVersion) == 0);
+        CHECK(strcmp(after.biosInfo.strDate, before.biosInfo.strDate) == 0);
+        CHECK_EQUAL(after.fanSpeedInfo.iFlags, before.fanSpeedInfo.iFlags);
+        CHECK_EQUAL(after.fanSpeedInfo.iMaxRPM, before.fanSpeedInfo.iMaxRPM);
+    }
+    CHECK(!(loaded.at(0).udid == loaded.at(1).udid));
+
+    // Anything but a metadata file is rejected.
+    CHECK(!AMDOverdrive::loadMetadata("/nonexistent/qtamd-metadata", loaded));
+    CHECK_EQUAL(loaded.size(), 0);
+}
+
+static void testSafetyWritesPreemptBulkReads() {
+    setUpRig(5, 3);
+    qputenv("QTAMD_MOCK_ADAPTERS", "4");
+    qputenv("QTAMD_MOCK_LATENCY_US", "20000");
+    AsyncOverdrive async;
+    // Waits for the driver thread to load the topology.
+    async.read(&AMDOverdrive::numberOfAdapters).waitForFinished();
+
+    typedef ADLResult<QList<AMDOverdrive::PerformanceLevelInfo> > (AMDOverdrive::*PerformanceLevels)(int);
+    QList<QFuture<ADLResult<QList<AMDOverdrive::PerformanceLevelInfo> > > > levels;
+    for(int adapterIndex = 0; adapterIndex < 4; adapterIndex++) {
+        levels.append(async.read(static_cast<PerformanceLevels>(&AMDOverdrive::performanceLevels), adapterIndex));
+    }
+    // Queued last, on the GPU of the last bulk read, yet runs before it.
+    QFuture<bool> write = async.write(&AMDOverdrive::setFanSpeedValue, 3, 0, AMDOverdrive::Percent, 50, false);
+    write.waitForFinished();
+    CHECK(!levels.last().isFinished());
+    levels.last().waitForFinished();
+    qputenv("QTAMD_MOCK_LATENCY_US", "0");
+    qputenv("QTAMD_MOCK_ADAPTERS", "1");
+
+    CHECK(write.result());
+    for(int i = 0; i < levels.size(); i++) {
+        CHECK_EQUAL(levels[i].result().returnCode(), ADL_OK);
+    }
+    AsyncOverdrive::PriorityCounters safety = async.priorityCounters(AsyncOverdrive::SafetyPriority);
+    AsyncOverdrive::PriorityCounters bulk = async.priorityCounters(AsyncOverdrive::BulkPriority);
+    CHECK_EQUAL(safety.executedRequests, 1);
+    CHECK_EQUAL(bulk.executedRequests, 4);
+    CHECK(safety.maxWaitMicroseconds < bulk.maxWaitMicroseconds);
+}
+
+struct Test {
+    const char *name;
+    void (*run)();
+};
+
+static const Test tests[] = {
+    { "performanceLevelsDontAllocate", testPerformanceLevelsDontAllocate },
+    { "moreThanMaxPerformanceLevels", testMoreThanMaxPerformanceLevels },
+    { "leakedBufferDoesntPinArena", testLeakedBufferDoesntPinArena },
+    { "reinitializeFailureIsReported", testReinitializeFailureIsReported },
+    { "contextIsCreatedAfterDestroy", testContextIsCreatedAfterDestroy },
+    { "privateContextEnumeratesThermalControllers", testPrivateContextEnumeratesThermalControllers },
+    { "rigWriteInvalidatesAdapterReads", testRigWriteInvalidatesAdapterReads },
+    { "outputsOfOneGpuShareAQueue", testOutputsOfOneGpuShareAQueue },
+    { "samplerKeepsSampling", testSamplerKeepsSampling },
+    { "monitorReportsChangesOfOneDeadband", testMonitorReportsChangesOfOneDeadband },
+    { "asyncReadsConstMethodsAndConvertsArguments", testAsyncReadsConstMethodsAndConvertsArguments },
+    { "clockRangeRoundsInwards", testClockRangeRoundsInwards },
+    { "sweepersShareOneEnumeration", testSweepersShareOneEnumeration },
+    { "circuitBreakerTripsAndBacksOff", testCircuitBreakerTripsAndBacksOff },
+    { "transactionCommitsInOneWrite", testTransactionCommitsInOneWrite },
+    { "editsAreRangeCheckedAndSnapped", testEditsAreRangeCheckedAndSnapped },
+    { "unchangedWritesAreSkipped", testUnchangedWritesAreSkipped },
+    { "metadataSurvivesSaveAndLoad", testMetadataSurvivesSaveAndLoad },
+    { "safetyWritesPreemptBulkReads", testSafetyWritesPreemptBulkReads }
+};
+
+int main(int argc, char *argv[]) {
+    const char *library = QTAMD_TESTS_MOCK_LIBRARY;
+    QList<QByteArray> selected;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "--library") == 0 && i + 1 < argc) {
+            library = argv[++i];
+        } else {
+            selected.append(argv[i]);
+        }
+    }
+
+    qputenv("QTAMD_ADL_LIBRARY", library);
+    void *mock = dlopen(library, RTLD_LAZY | RTLD_GLOBAL);
+    if(!mock) {
+        printf("Can't load the mock ADL library %s\n", library);
+        return 1;
+    }
+    mockNumberOfCalls = (NumberOfCallsFunction)dlsym(mock, "QtAMDMock_NumberOfCalls");
+    mockNumberOfLegacyCalls = (NumberOfCallsFunction)dlsym(mock, "QtAMDMock_NumberOfLegacyCalls");
+    mockSetFailingFunctions = (SetFailingFunctionsFunction)dlsym(mock, "QtAMDMock_SetFailingFunctions");
+
+    int failedTests = 0;
+    int numberOfTests = 0;
+    for(size_t i = 0; i < sizeof(tests) / sizeof(Test); i++) {
+        if(!selected.isEmpty() && !selected.contains(tests[i].name)) {
+            continue;
+        }
+        int failedChecksBefore = failedChecks;
+        tests[i].run();
+        bool passed = failedChecks == failedChecksBefore;
+        printf("%s %s\n", passed ? "PASS" : "FAIL", tests[i].name);
+        failedTests += passed ? 0 : 1;
+        numberOfTests++;
+    }
+    printf("%d of %d tests passed\n", numberOfTests - failedTests, numberOfTests);
+    return failedTests;
+}
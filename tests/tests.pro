@@ -0,0 +1,27 @@
+# Checks QtAMD against the mock ADL library. Build the library
+# (../qtamd.pro) and the mock (../mock/mock.pro) first, then run
+# `make check`.
+TEMPLATE = app
+
+CONFIG += console c++11 testcase
+CONFIG -= app_bundle
+TARGET = qtamd-tests
+
+SOURCES += \
+    main.cpp
+QT += core
+
+INCLUDEPATH += \
+    ..
+
+DEFINES += \
+    QTAMD_TESTS_MOCK_LIBRARY=\\\"$$OUT_PWD/../mock/libatiadlxx.so\\\"
+
+LIBS += \
+    -L$$OUT_PWD/.. -lqtamd
+
+PRE_TARGETDEPS += \
+    $$OUT_PWD/../libqtamd.a
+
+LIBS += \
+    -ldl